@@ -0,0 +1,387 @@
+#include <atomic>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <memory>
+#include <new>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include "board.h"
+#include "hud.h"
+#include "kernel.h"
+#include "profiler.h"
+#include "recording.h"
+
+// headless tick throughput benchmark
+//
+// usage: rainbow_life_bench [-s WIDTHxHEIGHT]... [-g GENERATIONS] [-r SEED] [-t THREADS] [-j LOG2] [-p PATTERN] [-o RECORDING] [-R RECORDING] [-b RULE] [-d DENSITY] [-u] [-v] [-F FONT] [-a]
+//
+// every board is filled with the same seed, so runs are reproducible and
+// comparable between builds. with -p, every board starts from a pattern
+// (centered on it) instead, to measure canonical workloads (breeders, Gemini, ...). without -g, the generation count is scaled to
+// the board size so every size simulates roughly the same number of cells.
+// active is the share of tiles actually computed (the rest were stable),
+// on bounded boards only (see -u).
+// with -j, every board does a single HashLife jump of 2^LOG2 generations instead.
+// with -o, every generation is recorded (see recording.h), and the recorded
+// bytes per generation, and per second at 60 generations per second are reported.
+// -b runs a rule other than Life (patterns may bring their own, see pattern.h).
+// -d sets the share of living cells of the random fill (0.2 by default),
+// fill is how long filling the board (cells and hues) took.
+// -u runs every board as a window onto an unbounded plane (see Grid::setUnbounded()),
+// and reports the chunks of the plane in use at the end, and the chunks
+// computed per generation on average (in place of active).
+// -R replays a recording instead of simulating, on a single board of its
+// size (looping over its records for more generations than it has).
+// -v renders every generation too, into an offscreen 1920x1080 surface, with
+// the rest of a frame of the main loop: the profiler summary drawn by the HUD
+// (with the font of -F, the same default as the window), and the copy of the
+// dirty rectangles.
+// allocs counts the heap allocations of all generations (ticks or replayed
+// records, and frames with -v) after the first warmup_generations, which
+// should be none: the engine reuses its memory from one generation to the
+// next. -a makes any of them an error (exit status 1), as a check (see make
+// check). operator new and the allocations of SDL and SDL_ttf (see
+// SDL_SetMemoryFunctions()) are counted, not those of the graphics driver,
+// and events and presenting aren't run.
+
+namespace {
+    struct Size {
+        size_t width, height;
+    };
+
+    const size_t default_cell_budget = size_t(1) << 28;
+
+    // generations allowed to allocate, while buffers grow to their size
+    const size_t warmup_generations = 8;
+
+    // every operator new of the process, and every allocation of SDL, see the replacements below
+    std::atomic<size_t> allocations(0);
+
+    // SDL's own, that the counting ones below call
+    SDL_malloc_func sdl_malloc;
+    SDL_calloc_func sdl_calloc;
+    SDL_realloc_func sdl_realloc;
+    SDL_free_func sdl_free;
+
+    void* countingMalloc(size_t size) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        return sdl_malloc(size);
+    }
+
+    void* countingCalloc(size_t count, size_t size) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        return sdl_calloc(count, size);
+    }
+
+    void* countingRealloc(void *memory, size_t size) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        return sdl_realloc(memory, size);
+    }
+
+    bool parseSize(const char *text, Size &size) {
+        char *end;
+        size.width = strtoul(text, &end, 10);
+        if (*end != 'x' && *end != 'X') {
+            return false;
+        }
+        size.height = strtoul(end + 1, &end, 10);
+        return *end == '\0' && size.width > 0 && size.height > 0;
+    }
+
+    // peak resident set size of the whole process, in kilobytes
+    long peakRss() {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+    }
+
+    // a share, with one decimal and a percent sign
+    std::string percent(double share) {
+        std::ostringstream text;
+        text << std::fixed << std::setprecision(1) << share << "%";
+        return text.str();
+    }
+
+    void usage(const char *name) {
+        std::cerr << "usage: " << name << " [-s WIDTHxHEIGHT]... [-g GENERATIONS] [-r SEED] [-t THREADS] [-j LOG2] [-p PATTERN] [-o RECORDING] [-R RECORDING] [-b RULE] [-d DENSITY] [-u] [-v] [-F FONT] [-a]" << std::endl;
+    }
+}
+
+// the default operator delete frees what this allocates
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+
+    void *memory = malloc(size ? size : 1);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+int main(int argc, char const *argv[])
+{
+    std::vector<Size> sizes;
+    size_t generations = 0;
+    uint64_t seed = 1;
+    size_t threads = 0;
+    int fast_forward_log2 = -1;
+    std::string pattern_path, recording_path, replay_path,
+                font_path = "/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf";
+    RainbowLife::Rule rule = RainbowLife::Rule::life();
+    double density = 0.2;
+    bool unbounded = false, rendering = false, allocation_check = false;
+    bool allocated = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 < argc && strcmp(argv[i], "-s") == 0) {
+            Size size;
+            if (!parseSize(argv[++i], size)) {
+                usage(argv[0]);
+                return 1;
+            }
+            sizes.push_back(size);
+        } else if (i + 1 < argc && strcmp(argv[i], "-g") == 0) {
+            generations = strtoul(argv[++i], nullptr, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "-r") == 0) {
+            seed = strtoull(argv[++i], nullptr, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "-t") == 0) {
+            threads = strtoul(argv[++i], nullptr, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "-j") == 0) {
+            char *end;
+            unsigned long log2 = strtoul(argv[++i], &end, 10);
+            if (*end != '\0' || log2 > RainbowLife::Grid::max_fast_forward_log2) {
+                usage(argv[0]);
+                return 1;
+            }
+            fast_forward_log2 = static_cast<int>(log2);
+        } else if (i + 1 < argc && strcmp(argv[i], "-p") == 0) {
+            pattern_path = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "-o") == 0) {
+            recording_path = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "-R") == 0) {
+            replay_path = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "-F") == 0) {
+            font_path = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "-b") == 0) {
+            try {
+                rule = RainbowLife::Rule::parse(argv[++i]);
+            } catch (const std::exception &exception) {
+                std::cerr << exception.what();
+                return 1;
+            }
+        } else if (i + 1 < argc && strcmp(argv[i], "-d") == 0) {
+            density = strtod(argv[++i], nullptr);
+        } else if (strcmp(argv[i], "-u") == 0) {
+            unbounded = true;
+        } else if (strcmp(argv[i], "-v") == 0) {
+            rendering = true;
+        } else if (strcmp(argv[i], "-a") == 0) {
+            allocation_check = true;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    // boards that tick instead of jumping (see Grid::fastForward()) would take forever
+    if ((!rule.isLifeLike() || unbounded) && fast_forward_log2 > static_cast<int>(RainbowLife::Grid::max_ticked_fast_forward_log2)) {
+        std::cerr << "-j is at most " << RainbowLife::Grid::max_ticked_fast_forward_log2
+                  << " for rules that aren't Life-like, and unbounded boards" << std::endl;
+        return 1;
+    }
+
+    // before SDL allocates anything, so everything it frees was counted
+    SDL_GetMemoryFunctions(&sdl_malloc, &sdl_calloc, &sdl_realloc, &sdl_free);
+    SDL_SetMemoryFunctions(countingMalloc, countingCalloc, countingRealloc, sdl_free);
+
+    if (rendering && TTF_Init() != 0) {
+        std::cerr << "unable to initialize SDL_ttf: " << TTF_GetError() << std::endl;
+        return 1;
+    }
+
+    std::unique_ptr<RainbowLife::Recording::Player> player;
+    RainbowLife::Frame replay_frame;
+    if (!replay_path.empty()) {
+        if (fast_forward_log2 >= 0) {
+            std::cerr << "-j doesn't replay" << std::endl;
+            return 1;
+        }
+
+        try {
+            player.reset(new RainbowLife::Recording::Player(replay_path));
+        } catch (const std::exception &exception) {
+            std::cerr << exception.what();
+            return 1;
+        }
+        sizes = { {player->width(), player->height()} };
+        generations = generations ? generations : player->recordCount();
+    }
+
+    if (sizes.empty()) {
+        sizes = { {192, 108}, {1024, 1024}, {4096, 4096}, {16384, 16384} };
+    }
+
+    std::cout << "kernel: " << RainbowLife::Kernel::instructionSet() << ", "
+              << "threads: " << (threads ? threads : std::thread::hardware_concurrency()) << ", "
+              << "rule: " << rule.name()
+              << (rule.range > 1 ? " (running sums)" : RainbowLife::Kernel::compile(rule).specialised ? "" : " (generic kernel)") << std::endl;
+
+    std::cout << std::setw(13) << "board"
+              << std::setw(8) << "gens"
+              << std::setw(12) << "seconds"
+              << std::setw(16) << "cells/s"
+              << std::setw(10) << "ns/cell"
+              << std::setw(9) << "active"
+              << std::setw(10) << "fill ms"
+              << std::setw(9) << "allocs"
+              << std::setw(14) << "peak RSS kB" << std::endl;
+
+    for (const Size &size : sizes) {
+        size_t cells = size.width * size.height;
+        size_t board_generations = generations;
+        if (fast_forward_log2 >= 0) {
+            board_generations = size_t(1) << fast_forward_log2;
+        } else if (board_generations == 0) {
+            board_generations = default_cell_budget / cells;
+            board_generations = board_generations < 1 ? 1 : board_generations > 1000 ? 1000 : board_generations;
+        }
+
+        // rendered boards draw into a surface of their own, freed with them
+        std::unique_ptr<SDL_Surface, void (*)(SDL_Surface*)> surface(
+            rendering ? SDL_CreateRGBSurfaceWithFormat(0, 1920, 1080, 32, SDL_PIXELFORMAT_ARGB8888) : nullptr,
+            SDL_FreeSurface);
+        if (rendering && !surface) {
+            std::cerr << "unable to create surface: " << SDL_GetError() << std::endl;
+            return 1;
+        }
+
+        std::unique_ptr<RainbowLife::Board> board_pointer(
+            surface ? new RainbowLife::Board(surface.get(), size.width, size.height, 1, seed)
+                    : new RainbowLife::Board(size.width, size.height, seed));
+        RainbowLife::Board &board = *board_pointer;
+        board.setThreadCount(threads);
+        board.setRule(rule);
+        if (unbounded) {
+            board.toggleUnbounded();
+        }
+
+        auto fill_begin = std::chrono::steady_clock::now();
+        board.randomizeBoard(density);
+        double fill_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - fill_begin).count();
+
+        if (!pattern_path.empty()) {
+            RainbowLife::Pattern::Options options;
+            options.centered = true;
+            board.loadPattern(pattern_path, options);
+        }
+
+        // tiles (chunks when unbounded) that were actually computed, see Grid
+        size_t active_tiles = 0;
+
+        // the rest of a frame of the main loop, with -v
+        RainbowLife::Profiler profiler;
+        std::unique_ptr<RainbowLife::Hud> hud(
+            rendering ? new RainbowLife::Hud(font_path, RainbowLife::Profiler::summary_columns, RainbowLife::Profiler::summary_lines)
+                      : nullptr);
+        std::vector<std::string> hud_lines;
+        std::vector<SDL_Rect> updated_rects;
+
+        // allocations after warmup, and the generations they are counted over
+        size_t steady_allocations = 0, steady_generations = 0;
+
+        if (!recording_path.empty()) {
+            board.startRecording(recording_path);
+        }
+
+        auto begin = std::chrono::steady_clock::now();
+        if (fast_forward_log2 >= 0) {
+            board.fastForward(fast_forward_log2);
+            active_tiles = board_generations * board.getGrid().tileCount();
+        } else {
+            for (size_t i = 0; i < board_generations; i++) {
+                size_t allocated_before = allocations.load(std::memory_order_relaxed);
+
+                if (player) {
+                    if (!player->next(replay_frame)) {
+                        player->seek(0, replay_frame);
+                    }
+                    board.restore(replay_frame);
+                } else {
+                    board.tick();
+                }
+                board.render();
+                active_tiles += board.getGrid().activeTileCount();
+
+                if (hud) {
+                    profiler.recordFrame(board.getFrame());
+                    profiler.summary(hud_lines);
+                    hud->update(hud_lines);
+
+                    updated_rects = board.getDirtyRects();
+                    hud->draw(surface.get());
+                    updated_rects.push_back(hud->getArea());
+                    profiler.endFrame();
+                }
+
+                if (i >= warmup_generations) {
+                    steady_allocations += allocations.load(std::memory_order_relaxed) - allocated_before;
+                    steady_generations++;
+                }
+            }
+        }
+        // waits for the recording to be written
+        if (!recording_path.empty()) {
+            board.stopRecording();
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        double seconds = std::chrono::duration<double>(end - begin).count();
+        double updates = static_cast<double>(cells) * board_generations;
+
+        std::cout << std::setw(13) << (std::to_string(size.width) + "x" + std::to_string(size.height))
+                  << std::setw(8) << board_generations
+                  << std::setw(12) << std::fixed << std::setprecision(4) << seconds
+                  << std::setw(16) << std::setprecision(0) << updates / seconds
+                  << std::setw(10) << std::setprecision(3) << seconds * 1e9 / updates
+                  << std::setw(9) << (unbounded || player ? std::string("-") : percent(100.0 * active_tiles / (board_generations * board.getGrid().tileCount())))
+                  << std::setw(10) << std::setprecision(1) << fill_seconds * 1e3
+                  << std::setw(9) << (steady_generations ? std::to_string(steady_allocations) : "-")
+                  << std::setw(14) << peakRss() << std::endl;
+
+        allocated = allocated || steady_allocations > 0;
+
+        if (unbounded) {
+            std::cout << std::setw(13) << "plane" << std::setw(8) << ""
+                      << board.getGrid().chunkCount() << " chunks";
+            // a jump doesn't count the chunks it computes
+            if (fast_forward_log2 < 0) {
+                std::cout << ", " << std::setprecision(1) << static_cast<double>(active_tiles) / board_generations
+                          << " computed per generation";
+            }
+            std::cout << std::endl;
+        }
+
+        struct stat recording;
+        if (!recording_path.empty() && stat(recording_path.c_str(), &recording) == 0) {
+            double bytes = static_cast<double>(recording.st_size) / board_generations;
+            std::cout << std::setw(13) << "recorded" << std::setw(8) << ""
+                      << std::setprecision(0) << bytes << " bytes/generation, "
+                      << std::setprecision(1) << bytes * 60 / (1 << 20) << " MB/s at 60 generations/s" << std::endl;
+        }
+    }
+
+    if (allocation_check && allocated) {
+        std::cerr << "heap allocations after warmup" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
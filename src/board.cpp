@@ -1,55 +1,252 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <string>
 #include <stdexcept>
 #include "board.h"
+#include "snapshot.h"
 #include "util.h"
 #include "log.hpp"
 
 namespace RainbowLife {
 
-    Board::Board(SDL_Surface *destination_surface, size_t table_width, size_t table_height, size_t cell_padding) :
-        destination_surface(destination_surface),
+    namespace {
+        // cells of cell_size (and the padding between them) that fit into pixels, at least one
+        size_t cellsFitting(int pixels, size_t cell_size, size_t cell_padding) {
+            return std::max<size_t>(1, (pixels + cell_padding) / (cell_size + cell_padding));
+        }
+
+        // samples of 2^shift cells covering cells, rounded up
+        size_t samplesCovering(size_t cells, size_t shift) {
+            return (cells + (size_t(1) << shift) - 1) >> shift;
+        }
+    }
+
+    Board::Board(size_t table_width, size_t table_height, uint64_t seed) :
+        destination_surface(nullptr),
+        renderer(nullptr),
+        texture(nullptr),
+        cell_padding(0),
         table_width(table_width),
         table_height(table_height),
-        cell_padding(cell_padding),
-        table(table_height, std::vector<Cell>(table_width, nullCell)),
-        nullCell{0.0, false, false},
+        fill_cell_size(0),
+        zoom_pixels(0),
+        zoom_shift(0),
+        view_x(0),
+        view_y(0),
+        view_width(table_width),
+        view_height(table_height),
+        cursor_x(-1),
+        cursor_y(-1),
+        cell_size(0),
+        sample_shift(0),
+        view_columns(table_width),
+        view_rows(table_height),
+        padding_top(0),
+        padding_left(0),
+        texture_source{0, 0, 0, 0},
+        texture_rect{0, 0, 0, 0},
+        color_format(SDL_PIXELFORMAT_UNKNOWN),
+        grid(table_width, table_height),
         deadCellsVisible{false},
-        wrap{true},
-        hoveredCell{&nullCell},
+        frame_stale{true},
+        simulation_stopping{false},
+        running{false},
+        tick_interval{100000},
+        tick_nanoseconds{0},
+        recording_pending{false},
+        hovered_x{-1},
+        hovered_y{-1},
         cursorEnabled{true},
-        cursorPainting{NOT_PAINTING}
+        cursorPainting{NOT_PAINTING},
+        drawn_hovered_x{-1},
+        drawn_hovered_y{-1},
+        render_dirty{true},
+        full_redraw{true},
+        direct_rasterising{false}
     {
-        if (static_cast<int>(table_width * (1 + cell_padding) - cell_padding) > destination_surface->w) {
-            throw std::runtime_error(::std::string("Insufficent surface width for cell table!\n") +
-                                     "    - surface width: " + std::to_string(destination_surface->w) + "px\n" +
+        if (table_width == 0 || table_height == 0) {
+            throw std::runtime_error(std::string("Invalid cell table dimensions!\n") +
                                      "    - table width: " + std::to_string(table_width) + "\n" +
-                                     "    - minimum cell size: 1px\n" +
-                                     "    - required surface width: " + std::to_string(table_width * (1 + cell_padding) - cell_padding) + "px\n");
+                                     "    - table height: " + std::to_string(table_height) + "\n");
         }
 
-        if (static_cast<int>(table_height * (1 + cell_padding) - cell_padding) > destination_surface->h) {
-            throw std::runtime_error(std::string("Insufficent surface height for cell table!\n") +
-                                     "    - surface height: " + std::to_string(destination_surface->h) + "px\n" +
-                                     "    - table height: " + std::to_string(table_height) + "\n" +
-                                     "    - minimum cell size: 1px\n" +
-                                     "    - required surface width: " + std::to_string(table_height * (1 + cell_padding) - cell_padding) + "px\n");
+        grid.setSeed(seed);
+        randomizeBoard();
+    }
+
+    Board::Board(SDL_Surface *destination_surface, size_t table_width, size_t table_height, size_t cell_padding, uint64_t seed) :
+        Board(table_width, table_height, seed)
+    {
+        this->destination_surface = destination_surface;
+        this->cell_padding = cell_padding;
+
+        computeColorTable(destination_surface->format);
+        layout();
+    }
+
+    Board::Board(SDL_Surface *destination_surface, CellSize cell_size, size_t cell_padding, uint64_t seed) :
+        Board(destination_surface,
+              cellsFitting(destination_surface->w, cell_size.pixels, cell_padding),
+              cellsFitting(destination_surface->h, cell_size.pixels, cell_padding),
+              cell_padding, seed)
+    {
+        fill_cell_size = cell_size.pixels;
+    }
+
+    Board::Board(SDL_Renderer *renderer, size_t table_width, size_t table_height, uint64_t seed) :
+        Board(table_width, table_height, seed)
+    {
+        this->renderer = renderer;
+
+        SDL_PixelFormat *format = SDL_AllocFormat(SDL_PIXELFORMAT_ARGB8888);
+        computeColorTable(format);
+        SDL_FreeFormat(format);
+
+        layout();
+    }
+
+    // fits the view to the surface (or renderer output): zoomed out, the whole
+    // table with the biggest cells that fit, zoomed in, as many cells of
+    // zoom_pixels (or samples of 2^zoom_shift cells) as fit. centered either way
+    void Board::layout() {
+        int output_width, output_height;
+        size_t padding = cell_padding;
+
+        if (renderer != nullptr) {
+            SDL_GetRendererOutputSize(renderer, &output_width, &output_height);
+            padding = 0;
+
+            int texture_width = 0, texture_height = 0;
+            if (texture != nullptr) {
+                SDL_QueryTexture(texture, nullptr, nullptr, &texture_width, &texture_height);
+            }
+
+            // the view never has more cells (or samples) than the output has pixels
+            if (texture_width != output_width || texture_height != output_height) {
+                if (texture != nullptr) {
+                    SDL_DestroyTexture(texture);
+                }
+
+                texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+                                            output_width, output_height);
+
+                if (texture == nullptr) {
+                    throw std::runtime_error(std::string("Unable to create board texture!\n") +
+                                             "    - output width: " + std::to_string(output_width) + "\n" +
+                                             "    - output height: " + std::to_string(output_height) + "\n" +
+                                             "    - error: " + SDL_GetError() + "\n");
+                }
+            }
+        } else if (destination_surface != nullptr) {
+            output_width = destination_surface->w;
+            output_height = destination_surface->h;
+        } else {
+            return;
+        }
+
+        // the whole table with the biggest cells that fit, or if not even a
+        // pixel per cell does, with the smallest samples that do
+        int fitting_size = std::min(static_cast<int>((output_width + padding) / table_width),
+                                    static_cast<int>((output_height + padding) / table_height)) - static_cast<int>(padding);
+        size_t fitting_shift = 0;
+
+        if (fitting_size < 1) {
+            fitting_shift = 1;
+            while (samplesCovering(table_width, fitting_shift) > static_cast<size_t>(output_width) ||
+                   samplesCovering(table_height, fitting_shift) > static_cast<size_t>(output_height)) {
+                fitting_shift++;
+            }
+        }
+
+        // zooming out past fitting goes back to fitting
+        if (zoom_pixels > 0 && fitting_size >= 1 && zoom_pixels <= static_cast<size_t>(fitting_size)) {
+            zoom_pixels = 0;
+        }
+        if (zoom_shift > 0 && (fitting_size >= 1 || zoom_shift >= fitting_shift)) {
+            zoom_shift = 0;
+        }
+
+        bool fit = zoom_pixels == 0 && zoom_shift == 0;
+        if (fit) {
+            view_x = view_y = 0;
+        }
+
+        sample_shift = fit ? fitting_shift : zoom_shift;
+        cell_size = sample_shift > 0 ? 1 : zoom_pixels > 0 ? zoom_pixels : fitting_size;
+        if (sample_shift > 0) {
+            padding = 0;
         }
 
-        // figuring out max cell size for given surface and table dimensions
-        size_t cell_size_x = (destination_surface->w + cell_padding) / table_width - cell_padding;
-        size_t cell_size_y = (destination_surface->h + cell_padding) / table_height - cell_padding;
+        // the view, aligned to its samples
+        size_t columns = samplesCovering(table_width, sample_shift),
+               rows = samplesCovering(table_height, sample_shift);
 
-        // min selection
-        cell_size = cell_size_x < cell_size_y ? cell_size_x : cell_size_y;
+        view_columns = std::min(columns, cellsFitting(output_width, cell_size, padding));
+        view_rows = std::min(rows, cellsFitting(output_height, cell_size, padding));
+        view_x = std::min(view_x >> sample_shift, columns - view_columns) << sample_shift;
+        view_y = std::min(view_y >> sample_shift, rows - view_rows) << sample_shift;
+        view_width = std::min(table_width - view_x, view_columns << sample_shift);
+        view_height = std::min(table_height - view_y, view_rows << sample_shift);
+
+        if (renderer != nullptr) {
+            if (fit && sample_shift > 0) {
+                // stretched over the output, keeping the aspect ratio
+                if (view_columns * output_height > view_rows * output_width) {
+                    texture_rect.w = output_width;
+                    texture_rect.h = view_rows * output_width / view_columns;
+                } else {
+                    texture_rect.w = view_columns * output_height / view_rows;
+                    texture_rect.h = output_height;
+                }
+            } else {
+                texture_rect.w = view_columns * cell_size;
+                texture_rect.h = view_rows * cell_size;
+            }
+
+            texture_rect.x = (output_width - texture_rect.w) / 2;
+            texture_rect.y = (output_height - texture_rect.h) / 2;
+            texture_source = { 0, 0, static_cast<int>(view_columns), static_cast<int>(view_rows) };
+            render_dirty = true;
+            return;
+        }
 
         // padding in pixels, to align the table in the middle
-        padding_top = (destination_surface->h - (table_height * (cell_size + cell_padding) - cell_padding)) / 2;
-        padding_left = (destination_surface->w - (table_width * (cell_size + cell_padding) - cell_padding)) / 2;
+        int view_pixels_x = view_columns * (cell_size + padding) - padding,
+            view_pixels_y = view_rows * (cell_size + padding) - padding;
+        padding_left = std::max(0, output_width - view_pixels_x) / 2;
+        padding_top = std::max(0, output_height - view_pixels_y) / 2;
+
+        drawn_cells.resize(view_columns * view_rows);
+
+        // the dead cell dot has to fit inside the cell for the scanlines to work
+        direct_rasterising = destination_surface->format->BytesPerPixel == 4 && cell_size >= 2;
+
+        // (samples are a pixel each, their scanline is a row of the view)
+        scanline.resize(view_columns * (cell_size + padding));
+        dot_scanline.resize(scanline.size());
+
+        full_redraw = true;
+        render_dirty = true;
+    }
+
+    Board::~Board() {
+        stopSimulation();
+        stopRecording();
+
+        if (saver.joinable()) {
+            saver.join();
+        }
 
-        randomizeBoard(5);
+        if (texture != nullptr) {
+            SDL_DestroyTexture(texture);
+        }
+    }
 
+    void Board::computeColorTable(const SDL_PixelFormat *format) {
         // color table precomputation
-        color_table.reserve(precomputed_colors);
+        color_table.resize(precomputed_colors);
         HSV hsv;
         RGB rgb;
         for (size_t i = 0; i < precomputed_colors; i++)
@@ -62,156 +259,666 @@ namespace RainbowLife {
 
             rgb = HSV2RGB(hsv);
 
-            color_table[i] = SDL_MapRGB(destination_surface->format, rgb.r * 255, rgb.g * 255, rgb.b * 255);
+            color_table[i] = SDL_MapRGB(format, rgb.r * 255, rgb.g * 255, rgb.b * 255);
+        }
+
+        // samples, from an eighth of the brightness for the sparsest ones
+        // (on a square root curve, so sparse regions still show)
+        sample_colors.resize(sample_shades * sample_hues);
+        for (size_t shade = 0; shade < sample_shades; shade++) {
+            for (size_t i = 0; i < sample_hues; i++) {
+                hsv.h = 360.0 * i / sample_hues;
+                hsv.s = 0.7;
+                hsv.v = 0.7 * std::sqrt((shade + 1.0) / sample_shades);
+
+                rgb = HSV2RGB(hsv);
+
+                sample_colors[shade * sample_hues + i] = SDL_MapRGB(format, rgb.r * 255, rgb.g * 255, rgb.b * 255);
+            }
         }
 
-        color_white = SDL_MapRGB(destination_surface->format, 255, 255, 255);
-        color_black = SDL_MapRGB(destination_surface->format, 0, 0, 0);
+        color_white = SDL_MapRGB(format, 255, 255, 255);
+        color_black = SDL_MapRGB(format, 0, 0, 0);
+        color_format = format->format;
     }
 
-    void Board::toggleWrap() {
-        wrap = !wrap;
+    bool Board::isHeadless() const {
+        return destination_surface == nullptr && texture == nullptr;
     }
 
-    void Board::clear() {
-        for (size_t y = 0; y < table_height; y++) {
-            for (size_t x = 0; x < table_width; x++) {
-                cell(x, y).alive_now = false;
+    const Grid& Board::getGrid() const {
+        return grid;
+    }
+
+    void Board::setThreadCount(size_t threads) {
+        grid.setThreadCount(threads);
+    }
+
+    void Board::startSimulation() {
+        if (simulation_thread.joinable()) {
+            return;
+        }
+
+        // publishing moves to the simulation thread, render() needs a frame until its first one
+        if (frame_stale) {
+            publishFrame();
+        }
+
+        simulation_stopping = false;
+        simulation_thread = std::thread(&Board::simulate, this);
+    }
+
+    void Board::stopSimulation() {
+        if (!simulation_thread.joinable()) {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex);
+            simulation_stopping = true;
+        }
+        wake.notify_one();
+        simulation_thread.join();
+
+        // commands queued after the last frame was published were still applied
+        frame_stale = true;
+    }
+
+    void Board::execute(Command::Type type, size_t x, size_t y, size_t value) {
+        Command command = { type, x, y, value, Rule() };
+        execute(command);
+    }
+
+    void Board::execute(const Command &command) {
+        if (!simulation_thread.joinable()) {
+            if (apply(command)) {
+                frame_stale = true;
             }
+            return;
+        }
+
+        while (!commands.push(command)) {
+            std::this_thread::yield();
+        }
+
+        // taking the lock makes sure the simulation thread is either before
+        // checking for commands, or already waiting, so the wakeup isn't lost
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex);
         }
+        wake.notify_one();
     }
 
-    void Board::randomizeColors() {
-        for (size_t y = 0; y < table_height; y++) {
-            for (size_t x = 0; x < table_width; x++) {
-                cell(x, y).color = static_cast<double>(rand()) / RAND_MAX;
+    // returns whether the grid changed
+    bool Board::apply(const Command &command) {
+        switch (command.type) {
+            case Command::TICK: tickGrid(); return true;
+            case Command::FAST_FORWARD: {
+                try {
+                    grid.fastForward(command.value);
+                } catch (const std::exception &exception) {
+                    log(exception.what());
+                    return false;
+                }
+            } break;
+            case Command::CLEAR: grid.clear(); break;
+            case Command::RANDOMIZE: grid.randomize(static_cast<double>(command.value) / Grid::density_steps, static_cast<Grid::HueField>(command.x)); break;
+            case Command::RANDOMIZE_COLORS: grid.randomizeHues(static_cast<Grid::HueField>(command.x)); break;
+            case Command::TOGGLE_WRAP: grid.toggleWrap(); break;
+            case Command::MOVE_WINDOW: grid.moveWindow(static_cast<int64_t>(command.x), static_cast<int64_t>(command.y)); break;
+            case Command::SET_RULE: grid.setRule(command.rule); break;
+            case Command::SET_ALIVE: {
+                // painted against the table as last drawn, which a resize
+                // (or a restore of a smaller board) may have shrunk since
+                if (command.x >= grid.width() || command.y >= grid.height()) {
+                    return false;
+                }
+                grid.setAlive(command.x, command.y, command.value);
+            } break;
+
+            case Command::TOGGLE_UNBOUNDED: {
+                try {
+                    grid.setUnbounded(!grid.isUnbounded());
+                } catch (const std::exception &exception) {
+                    log(exception.what());
+                    return false;
+                }
+            } break;
+
+            case Command::SET_RUNNING: {
+                running = command.value;
+            } return false;
+
+            case Command::SET_TICK_INTERVAL: {
+                tick_interval = std::chrono::microseconds(command.value);
+            } return false;
+
+            case Command::SNAPSHOT: {
+                std::string path;
+                std::unique_ptr<Frame> restored;
+                {
+                    std::lock_guard<std::mutex> lock(file_mutex);
+                    path.swap(save_path);
+                    restored.swap(restored_frame);
+                }
+
+                if (!path.empty()) {
+                    // the previous save may still be writing saved_frame
+                    if (saver.joinable()) {
+                        saver.join();
+                    }
+
+                    grid.copyTo(saved_frame);
+                    saver = std::thread([this, path]() {
+                        try {
+                            Snapshot::save(saved_frame, path);
+                            log("saved ", path);
+                        } catch (const std::exception &exception) {
+                            log(exception.what());
+                        }
+                    });
+                }
+
+                if (!restored) {
+                    return false;
+                }
+
+                if (restored->width != grid.width() || restored->height != grid.height()) {
+                    endRecording();
+                }
+                grid.restore(*restored);
+
+                {
+                    std::lock_guard<std::mutex> lock(file_mutex);
+                    spare_frame.swap(restored);
+                }
+            } break;
+
+            case Command::PATTERN: {
+                std::string path;
+                Pattern::Options options;
+                {
+                    std::lock_guard<std::mutex> lock(file_mutex);
+                    path.swap(pattern_path);
+                    options = pattern_options;
+                }
+
+                try {
+                    Pattern::load(path, grid, options);
+                } catch (const std::exception &exception) {
+                    // the board may be half loaded by now
+                    log(exception.what());
+                }
+            } break;
+
+            case Command::RECORD: {
+                std::string path;
+                {
+                    std::lock_guard<std::mutex> lock(file_mutex);
+                    path.swap(recording_path);
+                }
+
+                endRecording();
+
+                if (!path.empty()) {
+                    try {
+                        recorder.reset(new Recording::Recorder(path, grid.width(), grid.height()));
+                        recorder->record(grid);
+                        recording_pending = false;
+                    } catch (const std::exception &exception) {
+                        log(exception.what());
+                    }
+                }
+            } return false;
+
+            case Command::RESIZE: {
+                if (command.x == grid.width() && command.y == grid.height()) {
+                    return false;
+                }
+
+                endRecording();
+                grid.resize(command.x, command.y);
+            } break;
+        }
+
+        // deltas only carry the hues of newborn cells, new hues of living ones need a keyframe
+        if (recorder && (command.type == Command::RANDOMIZE || command.type == Command::RANDOMIZE_COLORS ||
+                         command.type == Command::SNAPSHOT || command.type == Command::PATTERN)) {
+            recorder->requestKeyframe();
+        }
+        recording_pending = true;
+
+        return true;
+    }
+
+    void Board::endRecording() {
+        if (recorder) {
+            recordPending();
+            log("recorded ", recorder->getPath());
+            recorder.reset();
+        }
+    }
+
+    void Board::recordPending() {
+        if (recorder && recording_pending) {
+            recorder->record(grid);
+        }
+        recording_pending = false;
+    }
+
+    void Board::tickGrid() {
+        recordPending();
+
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        grid.tick();
+        tick_nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+
+        if (recorder) {
+            recorder->record(grid);
+        }
+    }
+
+    void Board::publishFrame() {
+        recordPending();
+
+        // however many ticks went by, only the tiles they changed are sampled
+        grid.updateMipmap();
+        grid.copyTo(frames.back());
+        frames.back().tick_nanoseconds = tick_nanoseconds;
+        frames.publish();
+        frame_stale = false;
+    }
+
+    void Board::simulate() {
+        typedef std::chrono::steady_clock clock;
+        clock::time_point previous = clock::now();
+        clock::duration accumulated(0);
+
+        // ticks done while the renderer still had an unread frame
+        bool unpublished = false;
+
+        while (true) {
+            // time only counts while running, measured before the commands
+            // (which may start or stop it) are applied
+            clock::time_point now = clock::now();
+            if (running) {
+                accumulated += now - previous;
+            }
+            previous = now;
+
+            // read before draining, so commands queued before stopSimulation() are never lost
+            bool stopping = simulation_stopping;
+            Command command;
+
+            while (commands.pop(command)) {
+                unpublished |= apply(command);
+            }
+
+            if (stopping) {
+                break;
+            }
+
+            if (!running) {
+                accumulated = clock::duration(0);
+            }
+
+            if (running && tick_interval.count() == 0) {
+                accumulated = clock::duration(0);
+                tickGrid();
+
+                if (!frames.pending()) {
+                    publishFrame();
+                    unpublished = false;
+                } else {
+                    unpublished = true;
+                }
+
+                continue;
+            }
+
+            size_t ticks = 0;
+            while (running && accumulated >= tick_interval && ticks < max_catch_up_ticks) {
+                tickGrid();
+                accumulated -= tick_interval;
+                ticks++;
+            }
+
+            // too far behind, the rest is dropped instead of ticking in a burst
+            if (accumulated >= tick_interval) {
+                accumulated = clock::duration(0);
+            }
+
+            if (ticks > 0 || unpublished) {
+                publishFrame();
+                unpublished = false;
+            }
+
+            std::unique_lock<std::mutex> lock(wake_mutex);
+            auto woken = [this]() {
+                return simulation_stopping || !commands.empty();
+            };
+
+            if (running) {
+                wake.wait_until(lock, clock::now() + (tick_interval - accumulated), woken);
+            } else {
+                wake.wait(lock, woken);
+            }
+        }
+    }
+
+    void Board::save(const std::string &path) {
+        {
+            std::lock_guard<std::mutex> lock(file_mutex);
+            save_path = path;
+        }
+        execute(Command::SNAPSHOT);
+    }
+
+    void Board::load(const std::string &path) {
+        std::unique_ptr<Frame> frame(new Frame());
+        Snapshot::load(path, *frame);
+
+        restore(std::move(frame));
+    }
+
+    void Board::restore(std::unique_ptr<Frame> frame) {
+        frame->rule.check();
+
+        {
+            std::lock_guard<std::mutex> lock(file_mutex);
+            restored_frame.swap(frame);
+
+            // one that wasn't picked up yet
+            if (frame && !spare_frame) {
+                spare_frame.swap(frame);
             }
         }
+        execute(Command::SNAPSHOT);
     }
 
-    void Board::randomizeBoard(size_t fillRatio) {
-        for (size_t y = 0; y < table_height; y++) {
-            for (size_t x = 0; x < table_width; x++) {
-                cell(x, y).alive_now = rand() % fillRatio == 0;
+    void Board::restore(const Frame &frame) {
+        frame.rule.check();
+
+        std::unique_ptr<Frame> copy;
+        {
+            std::lock_guard<std::mutex> lock(file_mutex);
+
+            // one that wasn't picked up yet is overwritten, its SNAPSHOT is still queued
+            if (restored_frame) {
+                *restored_frame = frame;
+                return;
             }
+            copy.swap(spare_frame);
         }
 
-        randomizeColors();
+        if (!copy) {
+            copy.reset(new Frame());
+        }
+        *copy = frame;
+
+        {
+            std::lock_guard<std::mutex> lock(file_mutex);
+            restored_frame.swap(copy);
+        }
+        execute(Command::SNAPSHOT);
     }
 
-    // cell selection with coordinates
-    Board::Cell& Board::cell(int x, int y) {
-        if (!wrap) {
-            if (x < 0 || x > static_cast<int>(table_width - 1) || y < 0 || y > static_cast<int>(table_height - 1)) {
-                return nullCell;
-            } else return table[y][x];
-        } else {
-            if (x < 0) {
-                x += table_width;
+    void Board::resize(size_t width, size_t height) {
+        if (width == 0 || height == 0) {
+            throw std::runtime_error(std::string("Invalid cell table dimensions!\n") +
+                                     "    - table width: " + std::to_string(width) + "\n" +
+                                     "    - table height: " + std::to_string(height) + "\n");
+        }
+
+        execute(Command::RESIZE, width, height);
+    }
+
+    void Board::resizeOutput(SDL_Surface *surface) {
+        if (isHeadless()) {
+            return;
+        }
+
+        if (renderer == nullptr) {
+            destination_surface = surface;
+
+            // the pixel format may change with the surface (moving to another display)
+            if (surface->format->format != color_format) {
+                computeColorTable(surface->format);
             }
-            if (x >= static_cast<int>(table_width)) {
-                x = x % table_width;
+
+            if (fill_cell_size > 0) {
+                resize(cellsFitting(surface->w, fill_cell_size, cell_padding),
+                       cellsFitting(surface->h, fill_cell_size, cell_padding));
             }
-            if (y >= static_cast<int>(table_height)) {
-                y = y % table_height;
+        }
+
+        // the table drawn until the resized one arrives
+        layout();
+    }
+
+    void Board::setCellPadding(size_t cell_padding) {
+        this->cell_padding = cell_padding;
+        layout();
+    }
+
+    void Board::zoom(int steps) {
+        if (isHeadless()) {
+            return;
+        }
+
+        // the cell to keep in place: the hovered one, or the one in the middle of the view
+        int anchor_x = view_x + view_width / 2,
+            anchor_y = view_y + view_height / 2,
+            pixel_x, pixel_y;
+
+        // pixels per cell
+        auto scale = [this]() {
+            return renderer ? static_cast<double>(texture_rect.w) / (view_columns << sample_shift)
+                 : sample_shift > 0 ? 1.0 / (size_t(1) << sample_shift)
+                 : cell_size + cell_padding;
+        };
+
+        int origin_x = renderer ? texture_rect.x : padding_left,
+            origin_y = renderer ? texture_rect.y : padding_top;
+
+        if (hovered_x >= 0) {
+            anchor_x = hovered_x;
+            anchor_y = hovered_y;
+            pixel_x = cursor_x;
+            pixel_y = cursor_y;
+        } else {
+            pixel_x = origin_x + (anchor_x - static_cast<int>(view_x) + 0.5) * scale();
+            pixel_y = origin_y + (anchor_y - static_cast<int>(view_y) + 0.5) * scale();
+        }
+
+        // cells of pixels, a pixel per cell, then samples of more and more cells
+        size_t pixels = sample_shift > 0 ? 0 : renderer ? texture_rect.w / view_columns : cell_size,
+               shift = sample_shift;
+        for (; steps > 0; steps--) {
+            if (shift > 0) {
+                shift--;
+                pixels = shift == 0 ? 1 : 0;
+            } else {
+                pixels *= 2;
             }
-            if (y < 0) {
-                y += table_height;
+        }
+        for (; steps < 0; steps++) {
+            if (pixels > 1) {
+                pixels /= 2;
+            } else {
+                pixels = 0;
+                shift++;
             }
-            return table[y][x];
         }
 
+        zoom_pixels = pixels;
+        zoom_shift = shift;
+        layout();
+
+        origin_x = renderer ? texture_rect.x : padding_left;
+        origin_y = renderer ? texture_rect.y : padding_top;
+
+        view_x = std::max(0, anchor_x - static_cast<int>((pixel_x - origin_x) / scale()));
+        view_y = std::max(0, anchor_y - static_cast<int>((pixel_y - origin_y) / scale()));
+        layout();
+
+        setCursorCoordinates(cursor_x, cursor_y);
+    }
+
+    void Board::pan(int dx, int dy) {
+        if (isHeadless()) {
+            return;
+        }
+
+        view_x = std::max(0, static_cast<int>(view_x) + dx);
+        view_y = std::max(0, static_cast<int>(view_y) + dy);
+        layout();
+
+        setCursorCoordinates(cursor_x, cursor_y);
+    }
+
+    SDL_Rect Board::getView() const {
+        SDL_Rect view = { static_cast<int>(view_x), static_cast<int>(view_y),
+                          static_cast<int>(view_width), static_cast<int>(view_height) };
+        return view;
+    }
 
+    void Board::startRecording(const std::string &path) {
+        {
+            std::lock_guard<std::mutex> lock(file_mutex);
+            recording_path = path;
+        }
+        execute(Command::RECORD);
     }
 
-    Board::Cell& Board::operator()(int x, int y) {
-        return cell(x, y);
+    void Board::stopRecording() {
+        startRecording("");
+    }
+
+    void Board::loadPattern(const std::string &path, const Pattern::Options &options) {
+        if (!simulation_thread.joinable()) {
+            Pattern::load(path, grid, options);
+            frame_stale = true;
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(file_mutex);
+            pattern_path = path;
+            pattern_options = options;
+        }
+        execute(Command::PATTERN);
+    }
+
+    void Board::setRunning(bool running) {
+        execute(Command::SET_RUNNING, 0, 0, running);
+    }
+
+    void Board::setTickInterval(std::chrono::microseconds interval) {
+        execute(Command::SET_TICK_INTERVAL, 0, 0, interval.count());
+    }
+
+    void Board::toggleWrap() {
+        execute(Command::TOGGLE_WRAP);
+    }
+
+    void Board::toggleUnbounded() {
+        execute(Command::TOGGLE_UNBOUNDED);
+    }
+
+    void Board::moveWindow(int64_t dx, int64_t dy) {
+        // negative distances go through the command as their two's complement
+        execute(Command::MOVE_WINDOW, static_cast<size_t>(dx), static_cast<size_t>(dy));
+    }
+
+    void Board::setRule(const Rule &rule) {
+        rule.check();
+        execute({ Command::SET_RULE, 0, 0, 0, rule });
+    }
+
+    void Board::clear() {
+        execute(Command::CLEAR);
+    }
+
+    void Board::randomizeColors(Grid::HueField field) {
+        execute(Command::RANDOMIZE_COLORS, field);
+    }
+
+    void Board::randomizeBoard(double density, Grid::HueField field) {
+        // in steps of the grid, so the density goes through the command queue exactly
+        density = std::min(std::max(density, 0.0), 1.0);
+        execute(Command::RANDOMIZE, field, 0, static_cast<size_t>(std::lround(density * Grid::density_steps)));
     }
 
     void Board::tick()
     {
-        for (int y = 0; y < static_cast<int>(table_height); y++) {
-            for (int x = 0; x < static_cast<int>(table_width); x++) {
-                size_t neighbours_alive = cell(x - 1, y - 1).alive_now +
-                                          cell(x - 1, y).alive_now +
-                                          cell(x - 1, y + 1).alive_now +
-                                          cell(x, y - 1).alive_now +
-                                          cell(x, y + 1).alive_now +
-                                          cell(x + 1, y - 1).alive_now +
-                                          cell(x + 1, y).alive_now +
-                                          cell(x + 1, y + 1).alive_now;
-
-                if (cell(x, y).alive_now) {
-                    cell(x, y).alive_next_tick = (neighbours_alive == 2 || neighbours_alive == 3);
-                } else {
-                    cell(x, y).alive_next_tick = (neighbours_alive == 3);
-                    if (cell(x, y).alive_next_tick) {
-
-                        // 0.0 itself is a color, so we must keep track of the first inheritance
-                        // it should just copy the color the first time and average the color every other time
-                        double inherited_color = 0.0;
-                        bool color_undefined = true;
-
-                        // some ugly macro functions to minimize code duplication
-                        #define inherit_color(from) do { \
-                            if(from.alive_now) { \
-                                if(color_undefined) { \
-                                    inherited_color = from.color; \
-                                    color_undefined = false; \
-                                } else { \
-                                    inherited_color = average_hue(inherited_color, from.color); \
-                                } \
-                            } \
-                        } while ( false )
-
-                        // inheriting color from every neighbour
-                        inherit_color(cell(x - 1, y - 1));
-                        inherit_color(cell(x - 1, y));
-                        inherit_color(cell(x - 1, y + 1));
-                        inherit_color(cell(x, y - 1));
-                        inherit_color(cell(x, y + 1));
-                        inherit_color(cell(x + 1, y - 1));
-                        inherit_color(cell(x + 1, y));
-                        inherit_color(cell(x + 1, y + 1));
-
-                        // random mutation in any direction
-                        double mutation = max_cell_mutation * rand() / RAND_MAX - ( max_cell_mutation / 2 );
-                        inherited_color = from_0_to_1(inherited_color + mutation);
-
-                        cell(x, y).color = inherited_color;
-                    }
-                }
-            }
+        execute(Command::TICK);
+    }
+
+    void Board::fastForward(unsigned log2_generations)
+    {
+        execute(Command::FAST_FORWARD, 0, 0, log2_generations);
+    }
+
+    void Board::setCursorCoordinates(size_t x, size_t y) {
+        if (isHeadless()) {
+            return;
         }
 
-        for (int y = 0; y < static_cast<int>(table_height); y++) {
-            for (int x = 0; x < static_cast<int>(table_width); x++) {
-                cell(x, y).alive_now = cell(x, y).alive_next_tick;
+        cursor_x = x;
+        cursor_y = y;
+
+        if (texture != nullptr) {
+            int x_offset = static_cast<int>(x) - texture_rect.x,
+                y_offset = static_cast<int>(y) - texture_rect.y;
+
+            if (x_offset >= 0 && x_offset < texture_rect.w &&
+                y_offset >= 0 && y_offset < texture_rect.h) {
+                hovered_x = view_x + (x_offset * view_columns / texture_rect.w << sample_shift);
+                hovered_y = view_y + (y_offset * view_rows / texture_rect.h << sample_shift);
+                render_dirty = true;
+
+                paint();
+            } else {
+                hovered_x = hovered_y = -1;
+                render_dirty = true;
             }
+
+            return;
         }
-    }
 
-    void Board::setCursorCoordinates(size_t x, size_t y) {
         if (x > padding_left &&
             x < destination_surface->w - padding_left &&
             y > padding_top &&
             y < destination_surface->h - padding_top) {
 
+            // samples are a pixel each
+            size_t pitch = sample_shift > 0 ? 1 : cell_size + cell_padding;
             size_t x_index, y_index;
-            x_index = (x - padding_left) / (cell_size + cell_padding);
-            y_index = (y - padding_top) / (cell_size + cell_padding);
+            x_index = (x - padding_left) / pitch;
+            y_index = (y - padding_top) / pitch;
+
+            if (x_index >= view_columns || y_index >= view_rows) {
+                hovered_x = hovered_y = -1;
+                render_dirty = true;
+                return;
+            }
 
-            hoveredCell = &cell(x_index, y_index);
+            hovered_x = view_x + (x_index << sample_shift);
+            hovered_y = view_y + (y_index << sample_shift);
+            render_dirty = true;
 
             paint();
 
         } else {
-            hoveredCell = &nullCell;
+            hovered_x = hovered_y = -1;
+            render_dirty = true;
         }
     }
 
     void Board::toggleCursor() {
         cursorEnabled = !cursorEnabled;
+        render_dirty = true;
     }
 
     void Board::setPaintingMode(PaintingMode mode) {
@@ -220,61 +927,491 @@ namespace RainbowLife {
     }
 
     void Board::paint() {
-        if (cursorEnabled && hoveredCell != &nullCell && cursorPainting != NOT_PAINTING) {
-            hoveredCell->alive_now = (cursorPainting == PAINTING_ALIVE);
+        if (cursorEnabled && hovered_x >= 0 && cursorPainting != NOT_PAINTING) {
+            execute(Command::SET_ALIVE, hovered_x, hovered_y, cursorPainting == PAINTING_ALIVE);
         }
     }
 
     void Board::toggleDeadCellVisibility() {
         deadCellsVisible = !deadCellsVisible;
+        render_dirty = true;
     }
 
-    void Board::render() {
-        SDL_FillRect(destination_surface, NULL, 0);
+    // everything that decides how a cell looks (apart from the cursor highlight):
+    // liveness, dying state and dead cell visibility in the low bits, hue in the high bits
+    Uint32 Board::cellKey(size_t x, size_t y) const {
+        const Frame &frame = frames.front();
+        bool alive = frame.alive(x, y);
+        uint8_t decay = frame.decayAt(x, y);
+
+        if (!alive && !decay && !deadCellsVisible) {
+            return 0;
+        }
+
+        return (alive ? 1 : decay ? 3 | decay << 2 : 2) | (static_cast<Uint32>(frame.hue(x, y)) << 16);
+    }
+
+    Uint32 Board::dyingColor(Hue hue, uint8_t decay, uint16_t states) const {
+        size_t shade = (sample_shades - 1) * (states - 1 - decay) / (states - 1);
+        return sample_colors[shade * sample_hues + hue * sample_hues / hue_circle];
+    }
 
-        size_t color_index;
-        Uint32 highlight_color, cell_color;
+    SDL_Rect Board::cellRect(size_t x, size_t y) const {
+        SDL_Rect rect;
+        rect.x = padding_left + (x - view_x) * (cell_size + cell_padding);
+        rect.y = padding_top + (y - view_y) * (cell_size + cell_padding);
+        rect.w = rect.h = cell_size;
+        return rect;
+    }
+
+    SDL_Rect Board::highlightRect(size_t x, size_t y) const {
+        SDL_Rect rect = cellRect(x, y);
+        rect.x -= 1;
+        rect.y -= 1;
+        rect.w = rect.h = cell_size + 2;
+        return rect;
+    }
 
-        SDL_Rect highlight_rect,
-                 cell_rect,
-                 dead_cell_rect;
+    void Board::drawCell(size_t x, size_t y) {
+        const Frame &frame = frames.front();
+        SDL_Rect cell_rect = cellRect(x, y);
+        Hue hue = frame.hue(x, y);
 
-        highlight_rect.w = highlight_rect.h = cell_size + 2;
-        cell_rect.w = cell_rect.h = cell_size;
-        dead_cell_rect.w = dead_cell_rect.h = 2;
+        if (frame.alive(x, y)) {
+            SDL_FillRect(destination_surface, &cell_rect, color_table[hue]);
+        } else if (uint8_t decay = frame.decayAt(x, y)) {
+            SDL_FillRect(destination_surface, &cell_rect, dyingColor(hue, decay, frame.rule.states));
+        } else {
+            SDL_FillRect(destination_surface, &cell_rect, color_black);
 
-        for (size_t y = 0; y < table_height; y++) {
-            for (size_t x = 0; x < table_width; x++) {
-                cell_rect.x = padding_left + x * (cell_size + cell_padding);
-                cell_rect.y = padding_top + y * (cell_size + cell_padding);
-                highlight_rect.x = cell_rect.x - 1;
-                highlight_rect.y = cell_rect.y - 1;
+            if (deadCellsVisible) {
+                SDL_Rect dead_cell_rect;
                 dead_cell_rect.x = cell_rect.x + cell_size / 2 - 1;
                 dead_cell_rect.y = cell_rect.y + cell_size / 2 - 1;
+                dead_cell_rect.w = dead_cell_rect.h = 2;
+
+                SDL_FillRect(destination_surface, &dead_cell_rect, color_table[hue]);
+            }
+        }
+    }
+
+    // writes the cells from begin to end (inclusive) of row y, and the padding
+    // between them, directly into the (already locked) surface
+    void Board::rasteriseSpan(size_t y, size_t begin, size_t end) {
+        const Frame &frame = frames.front();
+        const size_t dot_offset = cell_size / 2 - 1;
+        Uint32 *line = scanline.data(),
+               *dot_line = dot_scanline.data();
+
+        for (size_t x = begin; x <= end; x++) {
+            if (x != begin) {
+                std::fill_n(line, cell_padding, color_black);
+                line += cell_padding;
+            }
+
+            bool alive = frame.alive(x, y);
+            uint8_t decay = frame.decayAt(x, y);
+            std::fill_n(line, cell_size, alive ? color_table[frame.hue(x, y)]
+                                               : decay ? dyingColor(frame.hue(x, y), decay, frame.rule.states) : color_black);
+            line += cell_size;
+        }
+
+        // the dots only show up in two rows, those get their own scanline
+        if (deadCellsVisible) {
+            std::copy(scanline.data(), line, dot_line);
+
+            for (size_t x = begin; x <= end; x++, dot_line += cell_size + cell_padding) {
+                if (!frame.alive(x, y) && !frame.decayAt(x, y)) {
+                    dot_line[dot_offset] = dot_line[dot_offset + 1] = color_table[frame.hue(x, y)];
+                }
+            }
+        }
+
+        SDL_Rect first = cellRect(begin, y);
+        size_t bytes = (line - scanline.data()) * sizeof(Uint32);
+        Uint8 *pixels = static_cast<Uint8*>(destination_surface->pixels) +
+                        first.y * destination_surface->pitch + first.x * sizeof(Uint32);
+
+        for (size_t row = 0; row < cell_size; row++) {
+            bool dot_row = deadCellsVisible && (row == dot_offset || row == dot_offset + 1);
+
+            std::memcpy(pixels, dot_row ? dot_scanline.data() : scanline.data(), bytes);
+            pixels += destination_surface->pitch;
+        }
+    }
+
+    void Board::addDirtyRect(SDL_Rect rect) {
+        // clipping to the surface, the highlight can stick out of it
+        if (rect.x < 0) {
+            rect.w += rect.x;
+            rect.x = 0;
+        }
+        if (rect.y < 0) {
+            rect.h += rect.y;
+            rect.y = 0;
+        }
+        rect.w = std::min(rect.w, destination_surface->w - rect.x);
+        rect.h = std::min(rect.h, destination_surface->h - rect.y);
+
+        if (rect.w > 0 && rect.h > 0) {
+            dirty_rects.push_back(rect);
+        }
+    }
+
+    const std::vector<SDL_Rect>& Board::getDirtyRects() const {
+        return dirty_rects;
+    }
+
+    void Board::invalidate(const SDL_Rect &area) {
+        if (destination_surface != nullptr) {
+            invalidated.push_back(area);
+            render_dirty = true;
+        }
+    }
+
+    const Frame& Board::getFrame() const {
+        return frames.front();
+    }
+
+    SDL_Texture* Board::getTexture() const {
+        return texture;
+    }
+
+    const SDL_Rect& Board::getTextureSource() const {
+        return texture_source;
+    }
+
+    const SDL_Rect& Board::getTextureRect() const {
+        return texture_rect;
+    }
+
+    Uint32 Board::sampleColor(const Mipmap::Sample &sample) const {
+        if (sample.density == 0) {
+            return color_black;
+        }
+
+        return sample_colors[sample.density * sample_shades / 256 * sample_hues + sample.hue * sample_hues / hue_circle];
+    }
 
-                color_index = cell(x, y).color * precomputed_colors;
+    void Board::sampleRow(size_t row, Uint32 *pixels) const {
+        const Frame &frame = frames.front();
+        size_t first_column = view_x >> sample_shift,
+               y = (view_y >> sample_shift) + row;
 
-                if (cell(x, y).alive_now) {
-                    highlight_color = color_white;
-                    cell_color = color_table[color_index];
+        if (sample_shift >= Mipmap::base_level) {
+            const Mipmap::Sample *samples = frame.mipmap.level(sample_shift) +
+                                            y * frame.mipmap.levelWidth(sample_shift) + first_column;
+
+            for (size_t column = 0; column < view_columns; column++) {
+                pixels[column] = sampleColor(samples[column]);
+            }
+        } else {
+            for (size_t column = 0; column < view_columns; column++) {
+                pixels[column] = sampleColor(Mipmap::sampleCells(frame.cells.data(), frame.words_per_row, frame.hues.data(),
+                                                                 frame.width, frame.height, sample_shift,
+                                                                 first_column + column, y));
+            }
+        }
+
+        // the sample of the hovered cell is highlighted as a whole
+        if (cursorEnabled && hovered_x >= 0 && static_cast<size_t>(hovered_y) >> sample_shift == y) {
+            size_t column = (static_cast<size_t>(hovered_x) >> sample_shift) - first_column;
+
+            if (column < view_columns) {
+                pixels[column] = color_white;
+            }
+        }
+    }
+
+    void Board::renderSamples() {
+        if (full_redraw) {
+            SDL_FillRect(destination_surface, NULL, color_black);
+            drawn_hovered_x = drawn_hovered_y = -1;
+            full_redraw = false;
+
+            SDL_Rect everything = { 0, 0, destination_surface->w, destination_surface->h };
+            addDirtyRect(everything);
+        }
+
+        for (const SDL_Rect &area : invalidated) {
+            SDL_FillRect(destination_surface, &area, color_black);
+            addDirtyRect(area);
+        }
+        invalidated.clear();
+
+        bool direct = destination_surface->format->BytesPerPixel == 4;
+
+        if (direct && SDL_MUSTLOCK(destination_surface)) {
+            SDL_LockSurface(destination_surface);
+        }
+
+        for (size_t row = 0; row < view_rows; row++) {
+            if (direct) {
+                Uint8 *pixels = static_cast<Uint8*>(destination_surface->pixels) +
+                                (padding_top + row) * destination_surface->pitch + padding_left * sizeof(Uint32);
+                sampleRow(row, reinterpret_cast<Uint32*>(pixels));
+                continue;
+            }
+
+            sampleRow(row, scanline.data());
+            for (size_t column = 0; column < view_columns; column++) {
+                SDL_Rect pixel = { static_cast<int>(padding_left + column), static_cast<int>(padding_top + row), 1, 1 };
+                SDL_FillRect(destination_surface, &pixel, scanline[column]);
+            }
+        }
+
+        if (direct && SDL_MUSTLOCK(destination_surface)) {
+            SDL_UnlockSurface(destination_surface);
+        }
+
+        SDL_Rect view = { static_cast<int>(padding_left), static_cast<int>(padding_top),
+                          static_cast<int>(view_columns), static_cast<int>(view_rows) };
+        addDirtyRect(view);
+    }
+
+    // one texel per cell of the view, so all of them are rewritten every
+    // time, dead cells are shown dimmed (there is no room for a dot) and the
+    // highlighted cell is white if alive and in its own color if dead
+    void Board::renderTexture() {
+        const Frame &frame = frames.front();
+        SDL_Rect area = { 0, 0, static_cast<int>(view_columns), static_cast<int>(view_rows) };
+        void *pixels;
+        int pitch;
+
+        if (SDL_LockTexture(texture, &area, &pixels, &pitch) != 0) {
+            return;
+        }
+
+        int highlighted_x = cursorEnabled ? hovered_x : -1,
+            highlighted_y = cursorEnabled ? hovered_y : -1;
+
+        for (size_t row_index = 0; row_index < view_rows; row_index++) {
+            Uint32 *row = reinterpret_cast<Uint32*>(static_cast<Uint8*>(pixels) + row_index * pitch);
+
+            if (sample_shift > 0) {
+                sampleRow(row_index, row);
+                continue;
+            }
+
+            size_t y = view_y + row_index;
+
+            for (size_t column = 0; column < view_columns; column++) {
+                size_t x = view_x + column;
+                bool alive = frame.alive(x, y);
+                Uint32 color = color_table[frame.hue(x, y)];
+
+                if (static_cast<int>(x) == highlighted_x && static_cast<int>(y) == highlighted_y) {
+                    row[column] = alive ? color_white : color;
+                } else if (alive) {
+                    row[column] = color;
+                } else if (uint8_t decay = frame.decayAt(x, y)) {
+                    row[column] = dyingColor(frame.hue(x, y), decay, frame.rule.states);
+                } else if (deadCellsVisible) {
+                    // a quarter of the brightness, the texture is always ARGB8888
+                    row[column] = ((color >> 2) & 0x003F3F3F) | 0xFF000000;
                 } else {
-                    cell_color = color_black;
-                    highlight_color = color_table[color_index];
+                    row[column] = color_black;
                 }
+            }
+        }
+
+        SDL_UnlockTexture(texture);
+        dirty_rects.push_back(texture_rect);
+    }
+
+    void Board::render() {
+        dirty_rects.clear();
+
+        if (isHeadless()) {
+            return;
+        }
+
+        // without a simulation thread, the frame is published here, on demand
+        if (!simulation_thread.joinable() && frame_stale) {
+            publishFrame();
+        }
+
+        if (frames.update()) {
+            render_dirty = true;
+
+            // the grid was resized (or a board of other dimensions restored)
+            const Frame &updated = frames.front();
+            if (updated.width != table_width || updated.height != table_height) {
+                table_width = updated.width;
+                table_height = updated.height;
+                layout();
+                setCursorCoordinates(cursor_x, cursor_y);
+            }
+        }
+
+        if (!render_dirty) {
+            return;
+        }
+        render_dirty = false;
 
-                if (cursorEnabled && hoveredCell == &cell(x, y)) {
-                    SDL_FillRect(destination_surface, &highlight_rect, highlight_color);
-                    SDL_FillRect(destination_surface, &cell_rect, cell_color);
+        const Frame &frame = frames.front();
+
+        if (texture != nullptr) {
+            renderTexture();
+            return;
+        }
+
+        if (sample_shift > 0) {
+            renderSamples();
+            return;
+        }
+
+        // an impossible key, for cells that have to be drawn no matter what
+        const Uint32 not_drawn = 0xFFFFFFFF;
+
+        if (full_redraw) {
+            SDL_FillRect(destination_surface, NULL, color_black);
+            std::fill(drawn_cells.begin(), drawn_cells.end(), not_drawn);
+            drawn_hovered_x = drawn_hovered_y = -1;
+            full_redraw = false;
+
+            SDL_Rect everything = { 0, 0, destination_surface->w, destination_surface->h };
+            addDirtyRect(everything);
+        }
+
+        // every cell that may reach into an invalidated area (with its highlight) is drawn again
+        const int pitch = cell_size + cell_padding;
+        for (const SDL_Rect &area : invalidated) {
+            SDL_FillRect(destination_surface, &area, color_black);
+            addDirtyRect(area);
+
+            // in cells of the view
+            int first_x = std::max(0, (area.x - static_cast<int>(padding_left)) / pitch - 1),
+                first_y = std::max(0, (area.y - static_cast<int>(padding_top)) / pitch - 1),
+                last_x = std::min(static_cast<int>(view_width) - 1, (area.x + area.w - static_cast<int>(padding_left)) / pitch + 1),
+                last_y = std::min(static_cast<int>(view_height) - 1, (area.y + area.h - static_cast<int>(padding_top)) / pitch + 1);
+
+            for (int y = first_y; y <= last_y; y++) {
+                for (int x = first_x; x <= last_x; x++) {
+                    drawn_cells[y * view_width + x] = not_drawn;
+                }
+            }
+        }
+        invalidated.clear();
+
+        const int first_x = view_x, first_y = view_y,
+                  end_x = view_x + view_width, end_y = view_y + view_height;
+
+        bool highlighting = cursorEnabled && hovered_x >= first_x && hovered_x < end_x &&
+                            hovered_y >= first_y && hovered_y < end_y;
+        int highlighted_x = highlighting ? hovered_x : -1,
+            highlighted_y = highlighting ? hovered_y : -1;
+        bool highlight_changed = highlighted_x != drawn_hovered_x || highlighted_y != drawn_hovered_y;
+
+        // erasing the old highlight, it may reach into the neighbouring
+        // cells (without padding), so those are drawn again too
+        if (highlight_changed && drawn_hovered_x >= 0) {
+            SDL_Rect old_highlight = highlightRect(drawn_hovered_x, drawn_hovered_y);
+            SDL_FillRect(destination_surface, &old_highlight, color_black);
+            addDirtyRect(old_highlight);
+
+            for (int y = drawn_hovered_y - 1; y <= drawn_hovered_y + 1; y++) {
+                for (int x = drawn_hovered_x - 1; x <= drawn_hovered_x + 1; x++) {
+                    if (x >= first_x && y >= first_y && x < end_x && y < end_y) {
+                        drawn_cells[(y - first_y) * view_width + (x - first_x)] = not_drawn;
+                    }
+                }
+            }
+        }
+
+        bool redraw_highlight = highlight_changed;
+
+        if (direct_rasterising && SDL_MUSTLOCK(destination_surface)) {
+            SDL_LockSurface(destination_surface);
+        }
+
+        for (size_t y = first_y; y < static_cast<size_t>(end_y); y++) {
+            // changed cells of the row are pushed as a single span, but only
+            // the runs of changed cells inside it are rasterised
+            int span_begin = -1, span_end = -1, run_begin = -1;
+            Uint32 *drawn_row = &drawn_cells[(y - first_y) * view_width] - first_x;
+
+            for (size_t x = first_x; x <= static_cast<size_t>(end_x); x++) {
+                bool changed = false;
+
+                if (x < static_cast<size_t>(end_x)) {
+                    Uint32 key = cellKey(x, y);
+                    Uint32 &drawn = drawn_row[x];
+
+                    changed = key != drawn;
+                    drawn = key;
+                }
+
+                if (changed) {
+                    if (!direct_rasterising) {
+                        drawCell(x, y);
+                    }
+
+                    if (span_begin < 0) {
+                        span_begin = x;
+                    }
+                    if (run_begin < 0) {
+                        run_begin = x;
+                    }
+                    span_end = x;
+                    continue;
+                }
+
+                if (run_begin < 0) {
+                    continue;
+                }
+
+                if (direct_rasterising) {
+                    rasteriseSpan(y, run_begin, x - 1);
                 }
 
-                if (cell(x, y).alive_now) {
-                    SDL_FillRect(destination_surface, &cell_rect, cell_color);
+                // the run (with the padding inside it) may have covered part of the highlight
+                if (highlighted_x >= 0 &&
+                    std::abs(static_cast<int>(y) - highlighted_y) <= 1 &&
+                    run_begin <= highlighted_x + 1 && static_cast<int>(x) - 1 >= highlighted_x - 1) {
+                    redraw_highlight = true;
                 }
 
-                if (!cell(x, y).alive_now && deadCellsVisible) {
-                    SDL_FillRect(destination_surface, &dead_cell_rect, color_table[color_index]);
+                run_begin = -1;
+            }
+
+            if (span_begin >= 0) {
+                SDL_Rect span = cellRect(span_begin, y);
+                span.w = (span_end - span_begin) * (cell_size + cell_padding) + cell_size;
+                addDirtyRect(span);
+            }
+        }
+
+        if (direct_rasterising && SDL_MUSTLOCK(destination_surface)) {
+            SDL_UnlockSurface(destination_surface);
+        }
+
+        if (highlighted_x >= 0 && redraw_highlight) {
+            Uint32 highlight_color = frame.alive(highlighted_x, highlighted_y) ? color_white
+                                                                               : color_table[frame.hue(highlighted_x, highlighted_y)];
+            SDL_Rect highlight = highlightRect(highlighted_x, highlighted_y);
+
+            SDL_FillRect(destination_surface, &highlight, highlight_color);
+            drawCell(highlighted_x, highlighted_y);
+            addDirtyRect(highlight);
+
+            // without padding, the living cells after the highlighted one
+            // (right and below) are drawn over the highlight
+            if (cell_padding == 0) {
+                const int after[4][2] = { {1, 0}, {-1, 1}, {0, 1}, {1, 1} };
+
+                for (const auto &offset : after) {
+                    int x = highlighted_x + offset[0],
+                        y = highlighted_y + offset[1];
+
+                    if (x >= first_x && x < end_x && y < end_y && frame.alive(x, y)) {
+                        drawCell(x, y);
+                    }
                 }
             }
         }
+
+        drawn_hovered_x = highlighted_x;
+        drawn_hovered_y = highlighted_y;
     }
 };
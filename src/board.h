@@ -2,64 +2,321 @@
 #define BOARD_H
 
 #include <SDL2/SDL.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <vector>
+#include "frame.hpp"
+#include "grid.h"
+#include "pattern.h"
+#include "recording.h"
+#include "spsc_queue.hpp"
+#include "triple_buffer.hpp"
 
 namespace RainbowLife {
     class Board {
     public:
-        struct Cell {
-            // hue, 0-1 interval
-            double color;
-
-            bool alive_now;
-            bool alive_next_tick;
-        };
         enum PaintingMode {
             NOT_PAINTING,
             PAINTING_ALIVE,
             PAINTING_DEAD
         };
 
+        // cell size in pixels, for boards filling their surface with as many cells as fit
+        struct CellSize {
+            size_t pixels;
+        };
+
       private:
-        // provided
+        // provided, a board draws either into a surface or into a texture
         SDL_Surface *destination_surface;
-        size_t table_width, table_height, cell_padding;
+        SDL_Renderer *renderer;
+        SDL_Texture *texture;
+        size_t cell_padding;
+
+        // dimensions of the frame drawn (the grid may have others by now, see resize())
+        size_t table_width, table_height;
+
+        // boards created with a CellSize resize their table to fill the surface
+        // with cells of that size, others keep theirs (0)
+        size_t fill_cell_size;
+
+        // view: zoomed in, zoom_pixels is the cell size in pixels (texels per
+        // cell for texture boards), zoomed out, every pixel (or texel) shows a
+        // sample of 2^zoom_shift x 2^zoom_shift cells from the mipmap of the
+        // frame. with neither, the whole table fits. only the cells from
+        // view_x, view_y on are shown, as many as fit
+        size_t zoom_pixels, zoom_shift;
+        size_t view_x, view_y, view_width, view_height;
+        int cursor_x, cursor_y;
+
+        // computed by layout(), from the surface (or renderer output) size and the view:
+        // the view is drawn as view_columns x view_rows cells of cell_size, or
+        // samples of 2^sample_shift cells, without padding
+        size_t cell_size, sample_shift, view_columns, view_rows, padding_top, padding_left;
 
-        // computed
-        size_t cell_size, padding_top, padding_left;
+        // texture boards draw the view into the top left of a texture of the
+        // output size (so never more than there are pixels), what part of the
+        // texture is shown, and where it's scaled to
+        SDL_Rect texture_source, texture_rect;
+
+        // pixel format the color table was computed for
+        Uint32 color_format;
+
+        void layout();
 
         // cells
-        std::vector<std::vector<Cell>> table;
-        Cell nullCell;
-        bool deadCellsVisible,
-             wrap;
+        Grid grid;
+        bool deadCellsVisible;
+
+        // simulation
+        // every change of the grid is a Command: without a simulation thread it
+        // is applied right away, with one (see startSimulation()) it is queued
+        // to that thread, which publishes every finished generation to render()
+        // through frames. render() only ever draws frames.front().
+        struct Command {
+            enum Type {
+                TICK,
+                FAST_FORWARD,
+                CLEAR,
+                RANDOMIZE,
+                RANDOMIZE_COLORS,
+                TOGGLE_WRAP,
+                TOGGLE_UNBOUNDED,
+                MOVE_WINDOW,
+                SET_ALIVE,
+                SET_RUNNING,
+                SET_TICK_INTERVAL,
+                SNAPSHOT,
+                PATTERN,
+                RECORD,
+                RESIZE,
+                SET_RULE
+            } type;
+            size_t x, y, value;
+            Rule rule;
+        };
+
+        SpscQueue<Command, 1024> commands;
+        TripleBuffer<Frame> frames;
+
+        // the grid changed since the last published frame (without a simulation thread)
+        bool frame_stale;
+
+        std::thread simulation_thread;
+        std::atomic<bool> simulation_stopping;
+
+        // only for sleeping, the simulation thread waits on wake for commands or its next tick
+        std::mutex wake_mutex;
+        std::condition_variable wake;
 
-        // cursor
-        Cell* hoveredCell;
+        // automatic ticking, owned by the simulation thread while it runs
+        // a zero interval means as fast as possible
+        bool running;
+        std::chrono::microseconds tick_interval;
+
+        // fixed timestep: elapsed time is accumulated, and every full interval
+        // in it is a tick, but after a stall only this many are caught up
+        static const size_t max_catch_up_ticks = 8;
+
+        // duration of the last tick, passed on in the frames
+        uint64_t tick_nanoseconds;
+
+        // snapshots and patterns (rare enough for a mutex), picked up by the
+        // SNAPSHOT and PATTERN commands:
+        // a save copies the grid into saved_frame, and writes that on the saver
+        // thread, a load reads the file on the calling thread and hands it over,
+        // patterns are read straight into the grid on the simulation thread
+        // a restored frame comes back as spare_frame (holding the previous
+        // board), to be copied into by the next restore(const Frame&)
+        std::mutex file_mutex;
+        std::string save_path, pattern_path, recording_path;
+        Pattern::Options pattern_options;
+        std::unique_ptr<Frame> restored_frame, spare_frame;
+        Frame saved_frame;
+        std::thread saver;
+
+        // recording, only touched by the simulation thread
+        // ticks are recorded right after they happen, other changes (painting
+        // can be many per frame) once, before the next tick or frame
+        std::unique_ptr<Recording::Recorder> recorder;
+        bool recording_pending;
+
+        void recordPending();
+        void endRecording();
+
+        void tickGrid();
+
+        void execute(Command::Type type, size_t x = 0, size_t y = 0, size_t value = 0);
+        void execute(const Command &command);
+        bool apply(const Command &command);
+        void publishFrame();
+        void simulate();
+
+        // cursor, hovered coordinates are -1 if no cell is hovered
+        int hovered_x, hovered_y;
         bool cursorEnabled;
         PaintingMode cursorPainting;
 
-        // mutation on cell birth
-        const double max_cell_mutation = 0.05;
-
-        // precomputed color table for hues
-        const size_t precomputed_colors = 100; 
+        // precomputed color table, one entry for every Hue, indexed by the hue itself
+        const size_t precomputed_colors = hue_circle;
         std::vector<Uint32> color_table;
 
+        // colors of samples, darker the fewer cells live in them, for the top
+        // 8 bits of their hue, see sampleColor()
+        static const size_t sample_shades = 8, sample_hues = 256;
+        std::vector<Uint32> sample_colors;
+
         // color consts
         Uint32 color_white, color_black;
 
+        // incremental rendering
+        // render() only redraws cells whose drawn state (see cellKey()) changed
+        // since the last frame, and collects the regions it touched in dirty_rects
+        // render_dirty is set by everything that can change the picture, an
+        // idle frame does nothing at all
+        std::vector<Uint32> drawn_cells;
+        int drawn_hovered_x, drawn_hovered_y;
+        bool render_dirty, full_redraw;
+        std::vector<SDL_Rect> dirty_rects;
+
+        // areas drawn over by someone else, see invalidate()
+        std::vector<SDL_Rect> invalidated;
+
+        Uint32 cellKey(size_t x, size_t y) const;
+        SDL_Rect cellRect(size_t x, size_t y) const;
+        SDL_Rect highlightRect(size_t x, size_t y) const;
+        void drawCell(size_t x, size_t y);
+
+        // dying cells of Generations rules fade out through the sample shades
+        Uint32 dyingColor(Hue hue, uint8_t decay, uint16_t states) const;
+        void addDirtyRect(SDL_Rect rect);
+
+        // direct rasterisation
+        // on 32 bit surfaces changed spans are written straight into the pixels:
+        // every cell row is built once as a scanline (plus one with the dead cell
+        // dots) and copied cell_size times, other surfaces fall back to drawCell()
+        bool direct_rasterising;
+        std::vector<Uint32> scanline, dot_scanline;
+
+        void rasteriseSpan(size_t y, size_t begin, size_t end);
+
+        // zoomed out, a row of the view is a row of samples, see Mipmap
+        // the whole view is drawn on every frame (it's no bigger than the output)
+        Uint32 sampleColor(const Mipmap::Sample &sample) const;
+        void sampleRow(size_t row, Uint32 *pixels) const;
+        void renderSamples();
+
+        void computeColorTable(const SDL_PixelFormat *format);
+        void renderTexture();
+
     public:
-        Board(SDL_Surface *destination_surface, size_t table_width, size_t table_height, size_t cell_padding = 4);
+        // headless board, simulation only (render() and cursor handling are no-ops)
+        // the seed drives every random choice (initial board, colors, mutations), see Grid
+        Board(size_t table_width, size_t table_height, uint64_t seed = 1);
+        Board(SDL_Surface *destination_surface, size_t table_width, size_t table_height, size_t cell_padding = 4, uint64_t seed = 1);
+
+        // as many cells of cell_size as fit into the surface, see resizeOutput()
+        Board(SDL_Surface *destination_surface, CellSize cell_size, size_t cell_padding = 1, uint64_t seed = 1);
+
+        // texture streaming board, every frame uploads the view, a texel per
+        // cell (or sample, zoomed out), see getTexture()
+        Board(SDL_Renderer *renderer, size_t table_width, size_t table_height, uint64_t seed = 1);
+
+        Board(const Board&) = delete;
+        Board& operator=(const Board&) = delete;
+        ~Board();
+
+        bool isHeadless() const;
+
+        // not to be used while the simulation thread runs
+        const Grid& getGrid() const;
+        void setThreadCount(size_t threads);
+
+        // moves the simulation onto its own thread: every grid change below is
+        // queued to it from then on, and ticks happen there (see setRunning())
+        // so a slow tick doesn't hold up input or rendering
+        void startSimulation();
+        void stopSimulation();
+
+        // saves the board to path in the background, see snapshot.h
+        void save(const std::string &path);
+
+        // replaces the board with the snapshot at path (dimensions included),
+        // throws if it can't be read
+        void load(const std::string &path);
+
+        // replaces the whole board with frame, dimensions and rule included
+        void restore(std::unique_ptr<Frame> frame);
+
+        // the same with a copy of frame, into the memory of a frame restored
+        // before, so restoring boards of the same dimensions over and over
+        // (like a replay) allocates nothing
+        void restore(const Frame &frame);
+
+        // resizes the table, keeping the cells centered, without stopping the
+        // simulation (the view follows once the resized generation is drawn)
+        // a recording ends, since it has the dimensions of the table
+        void resize(size_t width, size_t height);
+
+        // after the window changed size: surface boards draw into surface from
+        // now on (their table is resized if it fills the surface), texture boards
+        // (pass nullptr) read the output size of their renderer again
+        void resizeOutput(SDL_Surface *surface);
+
+        void setCellPadding(size_t cell_padding);
 
-        Cell& cell(int x, int y);
-        Cell& operator()(int x, int y);
+        // zooms in (positive steps) or out by factors of two, around the
+        // hovered cell if any, down to fitting the whole table
+        // past a pixel per cell, pixels show the density and hue of the cells
+        // they cover (dead cells aren't shown then)
+        void zoom(int steps);
+
+        // moves the view by whole cells, within the table
+        void pan(int dx, int dy);
+
+        // the visible cells
+        SDL_Rect getView() const;
+
+        // records every generation from now on to path, see recording.h
+        // (errors are logged), until stopped or started again
+        void startRecording(const std::string &path);
+        void stopRecording();
+
+        // reads the pattern at path into the board, see pattern.h
+        // errors are thrown if the simulation thread isn't running, and logged
+        // if it is (since the pattern is read there)
+        void loadPattern(const std::string &path, const Pattern::Options &options);
+
+        // automatic ticking on the simulation thread, one tick every interval
+        // (on average, independent of how long the ticks take)
+        // a zero interval ticks as fast as possible, publishing a frame only when
+        // render() took the previous one, so several ticks go into every frame
+        void setRunning(bool running);
+        void setTickInterval(std::chrono::microseconds interval);
 
         void toggleWrap();
+
+        // switches between a bounded board and a window onto an unbounded
+        // plane, see Grid::setUnbounded() (errors are logged)
+        void toggleUnbounded();
+
+        // moves the window of an unbounded board over its plane, by cells
+        void moveWindow(int64_t dx, int64_t dy);
+
+        // the rule of every tick from now on, throws for rules with B0 (see Rule::check())
+        void setRule(const Rule &rule);
+
         void clear();
-        void randomizeBoard(size_t fillRatio = 5);
-        void randomizeColors();
+        // density is the share of living cells (0 to 1), see Grid::randomize()
+        void randomizeBoard(double density = 0.2, Grid::HueField field = Grid::RANDOM_HUES);
+        void randomizeColors(Grid::HueField field = Grid::RANDOM_HUES);
         void tick();
+        void fastForward(unsigned log2_generations);
 
         void setCursorCoordinates(size_t x, size_t y);
         void toggleCursor();
@@ -67,7 +324,27 @@ namespace RainbowLife {
         void paint();
 
         void toggleDeadCellVisibility();
+
+        // draws what changed since the last call, see getDirtyRects()
         void render();
+
+        // the next render() clears area and draws the cells in it again
+        // (for overlays drawn onto the surface, once they are gone)
+        void invalidate(const SDL_Rect &area);
+
+        // the generation shown by the last render()
+        const Frame& getFrame() const;
+
+        // regions of the surface touched by the last render(), empty on idle frames
+        // (for texture boards the texture rectangle, if the texture changed)
+        const std::vector<SDL_Rect>& getDirtyRects() const;
+
+        // nullptr for surface boards
+        SDL_Texture* getTexture() const;
+
+        // the part of the texture drawn into, to be scaled to getTextureRect()
+        const SDL_Rect& getTextureSource() const;
+        const SDL_Rect& getTextureRect() const;
     };
 }
 
@@ -0,0 +1,74 @@
+#ifndef FRAME_HPP
+#define FRAME_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "hue.hpp"
+#include "mipmap.h"
+#include "rule.h"
+
+namespace RainbowLife {
+    // a finished generation, as handed from the simulation to the renderer
+    // liveness uses the bit layout of Grid (64 cells per word, every row
+    // starting on a new word), see Grid::copyTo()
+    struct Frame {
+        size_t width, height, words_per_row;
+        uint64_t generation;
+
+        // living cells, cells born and died in the last tick, and how long it took
+        uint64_t population, births, deaths;
+        uint64_t tick_nanoseconds;
+
+        // the rest of the grid state, for snapshots
+        bool wrap;
+        Rule rule;
+        uint64_t seed, randomizations;
+
+        std::vector<uint64_t> cells;
+        std::vector<Hue> hues;
+
+        // dying state of every cell (1 to rule.states - 2, 0 if not dying),
+        // empty for two-state rules, and in frames that have none
+        std::vector<uint8_t> decay;
+
+        // for drawing zoomed out, empty in frames read from files
+        Mipmap mipmap;
+
+        // the version of every tile of the grid copied into the frame, so the
+        // next copy only takes the tiles changed since, see Grid::copyTo()
+        // empty in frames read from files
+        std::vector<uint64_t> tile_versions;
+
+        // dimensions of frames read from files: at least a cell, at most
+        // max_dimension cells a side (Grid takes int coordinates) and
+        // max_cells cells in all, so their sizes never overflow
+        static const uint64_t max_dimension = uint64_t(1) << 30;
+        static const uint64_t max_cells = uint64_t(1) << 32;
+
+        static bool validDimensions(uint64_t width, uint64_t height) {
+            return width != 0 && height != 0 && width <= max_dimension && height <= max_dimension &&
+                   width * height <= max_cells;
+        }
+
+        Frame() :
+            width(0), height(0), words_per_row(0), generation(0),
+            population(0), births(0), deaths(0), tick_nanoseconds(0),
+            wrap(true), rule(Rule::life()), seed(0), randomizations(0) {}
+
+        // coordinates have to be on the board
+        bool alive(size_t x, size_t y) const {
+            return (cells[y * words_per_row + x / 64] >> (x % 64)) & 1;
+        }
+
+        Hue hue(size_t x, size_t y) const {
+            return hues[y * width + x];
+        }
+
+        uint8_t decayAt(size_t x, size_t y) const {
+            return decay.empty() ? 0 : decay[y * width + x];
+        }
+    };
+}
+
+#endif /* FRAME_HPP */
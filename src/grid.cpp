@@ -0,0 +1,1064 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include "grid.h"
+#include "kernel.h"
+#include "random.hpp"
+
+namespace RainbowLife {
+
+    namespace {
+        inline bool bit(const Grid::Word *row, size_t x) {
+            return (row[x / Grid::word_bits] >> (x % Grid::word_bits)) & 1;
+        }
+
+        // fraction / 65536 of the way from a to b, the short way around the hue circle
+        inline Hue blendHue(Hue a, Hue b, int32_t fraction) {
+            return a + static_cast<Hue>(static_cast<int16_t>(b - a) * fraction / 65536);
+        }
+    }
+
+    Grid::Grid(size_t width, size_t height, size_t threads) :
+        copy_count(0),
+        wrap{true},
+        origin_x(0),
+        origin_y(0),
+        window_edited(false),
+        kernel(Kernel::compile(Rule::life())),
+        random_seed(1),
+        generation_count(0),
+        randomizations(0),
+        mutation_key(0),
+        population_count(0),
+        last_births(0),
+        last_deaths(0)
+    {
+        layout(width, height);
+
+        planes[0].assign(words_per_row * grid_height, 0);
+        planes[1].assign(words_per_row * grid_height, 0);
+        current = planes[0].data();
+        next = planes[1].data();
+        hues.assign(width * height, 0);
+
+        setThreadCount(threads);
+    }
+
+    void Grid::layout(size_t width, size_t height) {
+        grid_width = width;
+        grid_height = height;
+        words_per_row = (width + word_bits - 1) / word_bits;
+        dead_row.assign(words_per_row, 0);
+
+        tiles_x = words_per_row;
+        tiles_y = (height + tile_rows - 1) / tile_rows;
+        tile_changed.assign(tiles_x * tiles_y, 1);
+        tile_changed_next.assign(tiles_x * tiles_y, 0);
+        tile_active.assign(tiles_x * tiles_y, 0);
+        active_tiles = 0;
+
+        tile_unsampled.assign(tiles_x * tiles_y, 1);
+        mipmap.resize(width, height);
+
+        tile_uncopied.assign(tiles_x * tiles_y, 0);
+        tile_stale.assign(tiles_x * tiles_y, 0);
+        tile_versions.assign(tiles_x * tiles_y, 0);
+
+        if (pool) {
+            setBands();
+        }
+    }
+
+    void Grid::setBands() {
+        size_t rows_per_thread = (grid_height + pool->size() - 1) / pool->size();
+        band_rows = (rows_per_thread + tile_rows - 1) / tile_rows * tile_rows;
+    }
+
+    size_t Grid::width() const {
+        return grid_width;
+    }
+
+    size_t Grid::height() const {
+        return grid_height;
+    }
+
+    bool Grid::alive(int x, int y) const {
+        if (!wrap) {
+            if (x < 0 || x > static_cast<int>(grid_width - 1) || y < 0 || y > static_cast<int>(grid_height - 1)) {
+                return false;
+            }
+        } else {
+            if (x < 0) {
+                x += grid_width;
+            }
+            if (x >= static_cast<int>(grid_width)) {
+                x = x % grid_width;
+            }
+            if (y >= static_cast<int>(grid_height)) {
+                y = y % grid_height;
+            }
+            if (y < 0) {
+                y += grid_height;
+            }
+        }
+
+        return (current[y * words_per_row + x / word_bits] >> (x % word_bits)) & 1;
+    }
+
+    void Grid::setAlive(size_t x, size_t y, bool alive) {
+        Word &word = current[y * words_per_row + x / word_bits];
+        Word mask = Word(1) << (x % word_bits);
+
+        if (alive != ((word & mask) != 0)) {
+            population_count += alive ? 1 : -1;
+        }
+
+        word = alive ? (word | mask) : (word & ~mask);
+        markTileChanged(x, y);
+
+        if (!decay.empty()) {
+            decay[y * grid_width + x] = 0;
+            dying[y * words_per_row + x / word_bits] &= ~mask;
+        }
+    }
+
+    void Grid::setAliveRun(size_t x, size_t y, size_t length) {
+        Word *row = current + y * words_per_row;
+        size_t end = x + length;
+
+        while (x < end) {
+            size_t shift = x % word_bits;
+            size_t bits = std::min(word_bits - shift, end - x);
+            Word mask = (bits == word_bits ? ~Word(0) : (Word(1) << bits) - 1) << shift;
+            Word &word = row[x / word_bits];
+
+            population_count += __builtin_popcountll(mask & ~word);
+            word |= mask;
+            markTileChanged(x, y);
+
+            if (!decay.empty()) {
+                std::fill(decay.begin() + y * grid_width + x, decay.begin() + y * grid_width + x + bits, 0);
+                dying[y * words_per_row + x / word_bits] &= ~mask;
+            }
+            x += bits;
+        }
+    }
+
+    Hue Grid::hue(size_t x, size_t y) const {
+        return hues[y * grid_width + x];
+    }
+
+    void Grid::setHue(size_t x, size_t y, Hue hue) {
+        setNewbornHue(x, y, hue);
+        window_edited = true;
+    }
+
+    void Grid::setNewbornHue(size_t x, size_t y, Hue hue) {
+        hues[y * grid_width + x] = hue;
+        tile_unsampled[y / tile_rows * tiles_x + x / word_bits] = 1;
+    }
+
+    uint64_t Grid::seed() const {
+        return random_seed;
+    }
+
+    void Grid::setSeed(uint64_t seed) {
+        random_seed = seed;
+        randomizations = 0;
+    }
+
+    uint64_t Grid::generation() const {
+        return generation_count;
+    }
+
+    size_t Grid::threadCount() const {
+        return pool->size();
+    }
+
+    void Grid::setThreadCount(size_t threads) {
+        pool.reset(new ThreadPool(threads));
+        setBands();
+    }
+
+    bool Grid::isWrapping() const {
+        return wrap;
+    }
+
+    void Grid::toggleWrap() {
+        wrap = !wrap;
+        markAllTilesChanged();
+    }
+
+    bool Grid::isUnbounded() const {
+        return unbounded_plane != nullptr;
+    }
+
+    void Grid::setUnbounded(bool unbounded) {
+        if (unbounded == isUnbounded()) {
+            return;
+        }
+
+        if (unbounded && !kernel.rule.isLifeLike()) {
+            throw std::runtime_error(std::string("Unsupported rule for an unbounded board!\n") +
+                                     "    - rule: " + kernel.rule.toString() + "\n");
+        }
+
+        // the window starts at the origin, and is loaded into the plane before the first tick
+        unbounded_plane.reset(unbounded ? new UnboundedGrid() : nullptr);
+        origin_x = origin_y = 0;
+        markAllTilesChanged();
+    }
+
+    void Grid::moveWindow(int64_t dx, int64_t dy) {
+        if (!unbounded_plane) {
+            return;
+        }
+
+        loadWindow();
+        origin_x += dx;
+        origin_y += dy;
+        unbounded_plane->store(current, hues.data(), grid_width, grid_height, origin_x, origin_y);
+
+        markAllTilesChanged();
+        window_edited = false;
+        countPopulation();
+        last_births = last_deaths = 0;
+    }
+
+    size_t Grid::chunkCount() const {
+        return unbounded_plane ? unbounded_plane->chunkCount() : 0;
+    }
+
+    void Grid::loadWindow() {
+        if (window_edited) {
+            unbounded_plane->load(current, hues.data(), grid_width, grid_height, origin_x, origin_y);
+            window_edited = false;
+        }
+    }
+
+    const Rule& Grid::getRule() const {
+        return kernel.rule;
+    }
+
+    void Grid::setRule(const Rule &rule) {
+        rule.check();
+
+        // dying cells don't carry over to another number of states
+        if (rule.states != kernel.rule.states) {
+            decay.assign(rule.states > 2 ? grid_width * grid_height : 0, 0);
+            dying.assign(rule.states > 2 ? words_per_row * grid_height : 0, 0);
+        }
+
+        // stable tiles may not be stable under the new rule
+        kernel = Kernel::compile(rule);
+        markAllTilesChanged();
+
+        // the plane only runs Life-like rules, the window stays as a bounded board
+        if (unbounded_plane && !rule.isLifeLike()) {
+            unbounded_plane.reset();
+        }
+    }
+
+    void Grid::rebuildDying() {
+        dying.assign(decay.empty() ? 0 : words_per_row * grid_height, 0);
+
+        for (size_t y = 0; y < grid_height && !decay.empty(); y++) {
+            for (size_t x = 0; x < grid_width; x++) {
+                uint8_t &state = decay[y * grid_width + x];
+
+                // living cells aren't dying, and no cell is dying past the last state
+                if (bit(current + y * words_per_row, x) || state >= kernel.rule.states - 1) {
+                    state = 0;
+                }
+                if (state) {
+                    dying[y * words_per_row + x / word_bits] |= Word(1) << (x % word_bits);
+                }
+            }
+        }
+    }
+
+    void Grid::clear() {
+        std::fill(current, current + words_per_row * grid_height, 0);
+        std::fill(decay.begin(), decay.end(), 0);
+        std::fill(dying.begin(), dying.end(), 0);
+        markAllTilesChanged();
+        population_count = 0;
+
+        // the whole plane, not just the window
+        if (unbounded_plane) {
+            unbounded_plane->clear();
+        }
+    }
+
+    void Grid::randomizeHues(HueField field) {
+        uint64_t key = Random::key(random_seed, Random::HUE, randomizations++);
+
+        // gradients start anywhere on the circle, and go around it once along
+        // the board, in the direction of angle
+        double angle = Random::unit(Random::cell(key, 0, 0)) * 2 * M_PI,
+               span = std::abs(std::cos(angle)) * grid_width + std::abs(std::sin(angle)) * grid_height;
+        int64_t gradient_start = static_cast<int64_t>(Random::cell(key, 1, 0) >> 48) << 16,
+                gradient_x = static_cast<int64_t>(std::cos(angle) / span * hue_circle * 65536),
+                gradient_y = static_cast<int64_t>(std::sin(angle) / span * hue_circle * 65536);
+
+        // noise: a random hue on every lattice point, blended between them
+        auto latticeHue = [key](size_t x, size_t y) {
+            return static_cast<Hue>(Random::cell(key, x, y) >> 48);
+        };
+        const size_t lattice_width = grid_width / noise_scale + 2;
+
+        pool->run(tiles_y, [&](size_t tile_y) {
+            std::vector<Hue> lattice_row(field == NOISE_HUES ? lattice_width : 0);
+
+            for (size_t y = tile_y * tile_rows; y < std::min(grid_height, (tile_y + 1) * tile_rows); y++) {
+                Hue *row = hues.data() + y * grid_width;
+
+                switch (field) {
+                    case RANDOM_HUES: {
+                        Kernel::randomHues(key, y, row, grid_width);
+                    } break;
+
+                    case NOISE_HUES: {
+                        int32_t fraction = (y % noise_scale) * 65536 / noise_scale;
+                        for (size_t i = 0; i < lattice_width; i++) {
+                            lattice_row[i] = blendHue(latticeHue(i, y / noise_scale), latticeHue(i, y / noise_scale + 1), fraction);
+                        }
+
+                        // along the row, in 16.16 fixed point steps from lattice point to lattice point
+                        for (size_t i = 0; i * noise_scale < grid_width; i++) {
+                            uint32_t value = uint32_t(lattice_row[i]) << 16,
+                                     step = static_cast<int16_t>(lattice_row[i + 1] - lattice_row[i]) * int32_t(65536 / noise_scale);
+                            Hue *end = row + std::min(grid_width, (i + 1) * noise_scale);
+
+                            for (Hue *hue = row + i * noise_scale; hue < end; hue++, value += step) {
+                                *hue = static_cast<Hue>(value >> 16);
+                            }
+                        }
+                    } break;
+
+                    case GRADIENT_HUES: {
+                        int64_t value = gradient_start + static_cast<int64_t>(y) * gradient_y;
+                        for (size_t x = 0; x < grid_width; x++, value += gradient_x) {
+                            row[x] = static_cast<Hue>(value >> 16);
+                        }
+                    } break;
+                }
+            }
+        });
+
+        std::fill(tile_unsampled.begin(), tile_unsampled.end(), 1);
+        window_edited = true;
+    }
+
+    void Grid::randomize(double density, HueField field) {
+        clear();
+
+        uint64_t key = Random::key(random_seed, Random::LIVENESS, randomizations);
+        uint32_t steps = static_cast<uint32_t>(std::lround(std::min(std::max(density, 0.0), 1.0) * density_steps));
+        const unsigned bits = __builtin_ctz(density_steps);
+        Word last_word_mask = grid_width % word_bits ? (Word(1) << (grid_width % word_bits)) - 1 : ~Word(0);
+
+        pool->run(tiles_y, [&](size_t tile_y) {
+            for (size_t y = tile_y * tile_rows; y < std::min(grid_height, (tile_y + 1) * tile_rows); y++) {
+                Word *row = current + y * words_per_row;
+
+                Kernel::randomRow(key, y, steps, bits, row, words_per_row);
+                row[words_per_row - 1] &= last_word_mask;
+            }
+        });
+
+        countPopulation();
+        randomizeHues(field);
+    }
+
+    Hue Grid::mutatedHue(Hue hue, size_t x, size_t y) const {
+        // random mutation in any direction, wrapping around the circle
+        Hue mutation = Random::cell(mutation_key, x, y) % (max_cell_mutation + 1);
+        return hue + mutation - max_cell_mutation / 2;
+    }
+
+    Hue Grid::inheritedHue(int x, int y) const {
+        // 0 itself is a color, so we must keep track of the first inheritance
+        // it should just copy the color the first time and average the color every other time
+        Hue inherited_color = 0;
+        bool color_undefined = true;
+
+        // inheriting color from every neighbour
+        for (int dx = -1; dx <= 1; dx++) {
+            for (int dy = -1; dy <= 1; dy++) {
+                if ((dx != 0 || dy != 0) && alive(x + dx, y + dy)) {
+                    int nx = (x + dx + grid_width) % grid_width,
+                        ny = (y + dy + grid_height) % grid_height;
+
+                    if (color_undefined) {
+                        inherited_color = hue(nx, ny);
+                        color_undefined = false;
+                    } else {
+                        inherited_color = average_hue(inherited_color, hue(nx, ny));
+                    }
+                }
+            }
+        }
+
+        // born without a living neighbour nearby (Larger than Life), the cell keeps its own
+        if (color_undefined) {
+            inherited_color = hue(x, y);
+        }
+
+        return mutatedHue(inherited_color, x, y);
+    }
+
+    Hue Grid::interiorInheritedHue(size_t x, size_t y) const {
+        Hue inherited_color = 0;
+        bool color_undefined = true;
+
+        for (size_t nx = x - 1; nx <= x + 1; nx++) {
+            for (size_t ny = y - 1; ny <= y + 1; ny++) {
+                if ((nx != x || ny != y) && bit(current + ny * words_per_row, nx)) {
+                    Hue neighbour_color = hues[ny * grid_width + nx];
+
+                    inherited_color = color_undefined ? neighbour_color : average_hue(inherited_color, neighbour_color);
+                    color_undefined = false;
+                }
+            }
+        }
+
+        if (color_undefined) {
+            inherited_color = hues[y * grid_width + x];
+        }
+
+        return mutatedHue(inherited_color, x, y);
+    }
+
+    void Grid::markTileChanged(size_t x, size_t y) {
+        tile_changed[y / tile_rows * tiles_x + x / word_bits] = 1;
+        tile_unsampled[y / tile_rows * tiles_x + x / word_bits] = 1;
+        window_edited = true;
+    }
+
+    void Grid::markAllTilesChanged() {
+        std::fill(tile_changed.begin(), tile_changed.end(), 1);
+        std::fill(tile_unsampled.begin(), tile_unsampled.end(), 1);
+        window_edited = true;
+    }
+
+    void Grid::findActiveTiles() {
+        std::fill(tile_active.begin(), tile_active.end(), 0);
+        active_tiles = 0;
+
+        for (size_t ty = 0; ty < tiles_y; ty++) {
+            for (size_t tx = 0; tx < tiles_x; tx++) {
+                if (!tile_changed[ty * tiles_x + tx]) {
+                    continue;
+                }
+
+                // a changed tile activates itself and its neighbours
+                for (int dy = -1; dy <= 1; dy++) {
+                    for (int dx = -1; dx <= 1; dx++) {
+                        int nx = static_cast<int>(tx) + dx,
+                            ny = static_cast<int>(ty) + dy;
+
+                        if (wrap) {
+                            nx = (nx + tiles_x) % tiles_x;
+                            ny = (ny + tiles_y) % tiles_y;
+                        } else if (nx < 0 || ny < 0 || nx >= static_cast<int>(tiles_x) || ny >= static_cast<int>(tiles_y)) {
+                            continue;
+                        }
+
+                        tile_active[ny * tiles_x + nx] = 1;
+                    }
+                }
+            }
+        }
+
+        for (uint8_t active : tile_active) {
+            active_tiles += active;
+        }
+    }
+
+    void Grid::tickRows(size_t begin, size_t end, uint64_t &births, uint64_t &deaths) {
+        for (size_t y = begin; y < end; y++) {
+            const Word *row = current + y * words_per_row,
+                       *above = y > 0 ? row - words_per_row
+                                      : wrap ? current + (grid_height - 1) * words_per_row : dead_row.data(),
+                       *below = y + 1 < grid_height ? row + words_per_row
+                                                    : wrap ? current : dead_row.data();
+            Word *next_row = next + y * words_per_row;
+            const uint8_t *active = &tile_active[y / tile_rows * tiles_x];
+
+            size_t run_begin = 0;
+            while (run_begin < tiles_x) {
+                // next run of active tiles in this row
+                while (run_begin < tiles_x && !active[run_begin]) {
+                    run_begin++;
+                }
+                size_t run_end = run_begin;
+                while (run_end < tiles_x && active[run_end]) {
+                    run_end++;
+                }
+                if (run_begin == run_end) {
+                    break;
+                }
+
+                Kernel::stepRow(kernel, above, row, below, next_row, grid_width, wrap, run_begin, run_end);
+                finishWords(y, run_begin, run_end, births, deaths);
+
+                run_begin = run_end;
+            }
+        }
+    }
+
+    void Grid::tickRowsRange(size_t begin, size_t end, std::vector<uint16_t> &columns,
+                             uint64_t &births, uint64_t &deaths) {
+        const Rule &rule = kernel.rule;
+        const int64_t range = rule.range, width = grid_width, height = grid_height;
+
+        // row y, wrapped around, or nullptr outside of the board with dead edges
+        auto rowAt = [&](int64_t y) -> const Word* {
+            if (y < 0 || y >= height) {
+                if (!wrap) {
+                    return nullptr;
+                }
+                y = (y % height + height) % height;
+            }
+            return current + y * words_per_row;
+        };
+
+        auto addRow = [&](int64_t y, uint16_t delta) {
+            const Word *row = rowAt(y);
+            for (size_t word = 0; row && word < words_per_row; word++) {
+                for (Word cells = row[word]; cells; cells &= cells - 1) {
+                    columns[word * word_bits + __builtin_ctzll(cells)] += delta;
+                }
+            }
+        };
+
+        auto column = [&](int64_t x) -> unsigned {
+            if (x < 0 || x >= width) {
+                if (!wrap) {
+                    return 0;
+                }
+                x = (x % width + width) % width;
+            }
+            return columns[x];
+        };
+
+        // living cells in rows [begin - range, begin + range] of every column
+        columns.assign(grid_width, 0);
+        for (int64_t dy = -range; dy <= range; dy++) {
+            addRow(static_cast<int64_t>(begin) + dy, 1);
+        }
+
+        for (size_t y = begin; y < end; y++) {
+            const Word *row = current + y * words_per_row;
+            Word *next_row = next + y * words_per_row;
+
+            // living cells in the square around cell x, the cell included
+            uint32_t window = 0;
+            for (int64_t x = -range; x <= range; x++) {
+                window += column(x);
+            }
+
+            std::fill(next_row, next_row + words_per_row, 0);
+            for (int64_t x = 0; x < width; x++) {
+                bool alive = bit(row, x);
+                uint32_t neighbours = window - alive;
+
+                if (alive ? neighbours >= rule.survival_min && neighbours <= rule.survival_max
+                          : neighbours >= rule.birth_min && neighbours <= rule.birth_max) {
+                    next_row[x / word_bits] |= Word(1) << (x % word_bits);
+                }
+
+                window += column(x + range + 1);
+                window -= column(x - range);
+            }
+
+            finishWords(y, 0, words_per_row, births, deaths);
+
+            // move the column sums a row down
+            if (y + 1 < end) {
+                addRow(static_cast<int64_t>(y) - range, static_cast<uint16_t>(-1));
+                addRow(static_cast<int64_t>(y) + range + 1, 1);
+            }
+        }
+    }
+
+    void Grid::finishWords(size_t y, size_t begin, size_t end, uint64_t &births, uint64_t &deaths) {
+        const Word *row = current + y * words_per_row;
+        Word *next_row = next + y * words_per_row;
+        uint8_t *changed = &tile_changed_next[y / tile_rows * tiles_x];
+
+        // hue inheritance only runs for the cells born in this row,
+        // cells on the outer ring go through the wrapping/dead edge path
+        bool border_row = y == 0 || y + 1 == grid_height;
+
+        for (size_t word = begin; word < end; word++) {
+            if (!dying.empty()) {
+                // dying cells can't be born, every tick takes them a state
+                // further, and cells that just died start dying
+                Word &dying_word = dying[y * words_per_row + word];
+                next_row[word] &= ~dying_word;
+                Word died = row[word] & ~next_row[word];
+
+                if (dying_word | died) {
+                    // keeps the tile active until they are all dead
+                    changed[word] = 1;
+
+                    for (Word cells = dying_word; cells; cells &= cells - 1) {
+                        size_t cell = __builtin_ctzll(cells);
+                        uint8_t &state = decay[y * grid_width + word * word_bits + cell];
+
+                        if (++state == kernel.rule.states - 1) {
+                            state = 0;
+                            dying_word &= ~(Word(1) << cell);
+                        }
+                    }
+
+                    for (Word cells = died; cells; cells &= cells - 1) {
+                        decay[y * grid_width + word * word_bits + __builtin_ctzll(cells)] = 1;
+                    }
+                    dying_word |= died;
+                }
+            }
+
+            if (next_row[word] == row[word]) {
+                continue;
+            }
+            changed[word] = 1;
+
+            Word born = next_row[word] & ~row[word];
+            births += __builtin_popcountll(born);
+            deaths += __builtin_popcountll(row[word] & ~next_row[word]);
+
+            while (born) {
+                size_t x = word * word_bits + __builtin_ctzll(born);
+                born &= born - 1;
+
+                if (border_row || x == 0 || x + 1 == grid_width) {
+                    setNewbornHue(x, y, inheritedHue(x, y));
+                } else {
+                    setNewbornHue(x, y, interiorInheritedHue(x, y));
+                }
+            }
+        }
+    }
+
+    void Grid::tickUnbounded() {
+        loadWindow();
+
+        mutation_key = Random::key(random_seed, Random::MUTATION, generation_count);
+        unbounded_plane->tick(kernel, mutation_key, max_cell_mutation, *pool);
+
+        // the window still holds the previous generation, only what changed is copied
+        std::fill(tile_changed.begin(), tile_changed.end(), 0);
+        last_births = last_deaths = 0;
+        unbounded_plane->storeChanges(current, hues.data(), grid_width, grid_height, origin_x, origin_y,
+                            tile_changed.data(), last_births, last_deaths);
+
+        population_count += last_births - last_deaths;
+        active_tiles = unbounded_plane->activeChunkCount();
+        generation_count++;
+
+        for (size_t tile = 0; tile < tile_changed.size(); tile++) {
+            tile_unsampled[tile] |= tile_changed[tile];
+        }
+    }
+
+    void Grid::tick() {
+        if (unbounded_plane) {
+            tickUnbounded();
+            return;
+        }
+
+        bool larger_than_life = kernel.rule.range > 1;
+
+        // the neighbourhood of Larger than Life rules reaches past the
+        // neighbouring tiles, every tile is computed then
+        if (larger_than_life) {
+            std::fill(tile_active.begin(), tile_active.end(), 1);
+            active_tiles = tile_active.size();
+        } else {
+            findActiveTiles();
+        }
+        std::fill(tile_changed_next.begin(), tile_changed_next.end(), 0);
+
+        // every band reads the current plane only (including the rows just
+        // outside of it), and writes its own rows of the next plane, the hues
+        // of its own newborn cells and the flags of its own tiles, so bands
+        // need no locking
+        size_t bands = (grid_height + band_rows - 1) / band_rows;
+
+        mutation_key = Random::key(random_seed, Random::MUTATION, generation_count);
+
+        band_births.assign(bands, 0);
+        band_deaths.assign(bands, 0);
+        band_columns.resize(bands);
+
+        pool->run(bands, [this, larger_than_life](size_t band) {
+            size_t begin = band * band_rows, end = std::min(grid_height, (band + 1) * band_rows);
+
+            if (larger_than_life) {
+                tickRowsRange(begin, end, band_columns[band], band_births[band], band_deaths[band]);
+            } else {
+                tickRows(begin, end, band_births[band], band_deaths[band]);
+            }
+        });
+
+        last_births = last_deaths = 0;
+        for (size_t band = 0; band < bands; band++) {
+            last_births += band_births[band];
+            last_deaths += band_deaths[band];
+        }
+        population_count += last_births - last_deaths;
+
+        std::swap(current, next);
+        tile_changed.swap(tile_changed_next);
+        generation_count++;
+
+        for (size_t tile = 0; tile < tile_changed.size(); tile++) {
+            tile_unsampled[tile] |= tile_changed[tile];
+        }
+    }
+
+    void Grid::fastForward(unsigned log2_generations) {
+        if (log2_generations > max_fast_forward_log2) {
+            log2_generations = max_fast_forward_log2;
+        }
+
+        // HashLife only knows two states and the 3 x 3 neighbourhood, and
+        // loads no more than the board
+        if (!kernel.rule.isLifeLike() || unbounded_plane) {
+            if (log2_generations > max_ticked_fast_forward_log2) {
+                log2_generations = max_ticked_fast_forward_log2;
+            }
+
+            for (uint64_t generation = 0; generation < uint64_t(1) << log2_generations; generation++) {
+                tick();
+            }
+            return;
+        }
+
+        // average hue of the living cells in every tile (and on the whole
+        // board), as the circular mean of their hues
+        const double radians_per_hue = 2 * M_PI / hue_circle;
+        std::vector<double> tile_x(tiles_x * tiles_y, 0.0), tile_y(tiles_x * tiles_y, 0.0);
+        double board_x = 0.0, board_y = 0.0;
+
+        for (size_t y = 0; y < grid_height; y++) {
+            for (size_t word = 0; word < words_per_row; word++) {
+                Word alive_cells = current[y * words_per_row + word];
+                size_t tile = y / tile_rows * tiles_x + word;
+
+                while (alive_cells) {
+                    size_t x = word * word_bits + __builtin_ctzll(alive_cells);
+                    alive_cells &= alive_cells - 1;
+
+                    double angle = hue(x, y) * radians_per_hue;
+                    tile_x[tile] += std::cos(angle);
+                    tile_y[tile] += std::sin(angle);
+                }
+            }
+        }
+
+        for (size_t tile = 0; tile < tile_x.size(); tile++) {
+            board_x += tile_x[tile];
+            board_y += tile_y[tile];
+        }
+
+        if (!hashlife || hashlife->getRule() != kernel.rule) {
+            hashlife.reset(new HashLife(kernel.rule));
+        }
+
+        hashlife->load(current, grid_width, grid_height, words_per_row);
+        try {
+            hashlife->step(log2_generations);
+        } catch (...) {
+            // the board is untouched, the node store is dropped
+            hashlife.reset();
+            throw;
+        }
+        hashlife->store(next, grid_width, grid_height, words_per_row);
+
+        for (size_t y = 0; y < grid_height; y++) {
+            for (size_t word = 0; word < words_per_row; word++) {
+                size_t index = y * words_per_row + word,
+                       tile = y / tile_rows * tiles_x + word;
+                Word births = next[index] & ~current[index];
+
+                if (!births) {
+                    continue;
+                }
+
+                bool tile_had_cells = tile_x[tile] != 0.0 || tile_y[tile] != 0.0;
+                double angle = tile_had_cells ? std::atan2(tile_y[tile], tile_x[tile])
+                                              : std::atan2(board_y, board_x);
+                Hue inherited_hue = static_cast<Hue>(static_cast<int64_t>(std::floor(angle / radians_per_hue)));
+
+                while (births) {
+                    size_t x = word * word_bits + __builtin_ctzll(births);
+                    births &= births - 1;
+
+                    setNewbornHue(x, y, inherited_hue);
+                }
+            }
+        }
+
+        std::swap(current, next);
+        markAllTilesChanged();
+        countPopulation();
+        generation_count += uint64_t(1) << log2_generations;
+    }
+
+    void Grid::countPopulation() {
+        population_count = 0;
+
+        for (size_t index = 0; index < words_per_row * grid_height; index++) {
+            population_count += __builtin_popcountll(current[index]);
+        }
+    }
+
+    uint64_t Grid::population() const {
+        return population_count;
+    }
+
+    uint64_t Grid::births() const {
+        return last_births;
+    }
+
+    uint64_t Grid::deaths() const {
+        return last_deaths;
+    }
+
+    namespace {
+        // the 64 cells of row starting at cell x (which may be negative), dead outside the row
+        inline Grid::Word bitsAt(const Grid::Word *row, size_t words, int64_t x) {
+            int64_t word = x >= 0 ? x / 64 : -((-x + 63) / 64);
+            unsigned shift = x - word * 64;
+
+            Grid::Word low = word >= 0 && word < static_cast<int64_t>(words) ? row[word] : 0,
+                       high = word + 1 >= 0 && word + 1 < static_cast<int64_t>(words) ? row[word + 1] : 0;
+
+            return shift ? (low >> shift) | (high << (64 - shift)) : low;
+        }
+    }
+
+    void Grid::resize(size_t width, size_t height) {
+        if (width == grid_width && height == grid_height) {
+            return;
+        }
+
+        if (unbounded_plane) {
+            loadWindow();
+        }
+
+        // position of the old board on the new one, negative if it's cropped
+        int64_t offset_x = (static_cast<int64_t>(width) - static_cast<int64_t>(grid_width)) / 2,
+                offset_y = (static_cast<int64_t>(height) - static_cast<int64_t>(grid_height)) / 2;
+
+        size_t old_width = grid_width, old_height = grid_height, old_words_per_row = words_per_row;
+        std::vector<Word> &old_plane = current == planes[0].data() ? planes[0] : planes[1],
+                          &new_plane = current == planes[0].data() ? planes[1] : planes[0];
+
+        layout(width, height);
+
+        // the next plane is reused for the new layout, then the old one becomes the next plane
+        new_plane.assign(words_per_row * height, 0);
+        std::vector<Hue> new_hues(width * height, 0);
+        std::vector<uint8_t> new_decay(decay.empty() ? 0 : width * height, 0);
+        Word last_word_mask = width % word_bits ? (Word(1) << (width % word_bits)) - 1 : ~Word(0);
+
+        for (size_t y = 0; y < height; y++) {
+            int64_t old_y = static_cast<int64_t>(y) - offset_y;
+            if (old_y < 0 || old_y >= static_cast<int64_t>(old_height)) {
+                continue;
+            }
+
+            const Word *old_row = old_plane.data() + old_y * old_words_per_row;
+            Word *row = new_plane.data() + y * words_per_row;
+
+            for (size_t word = 0; word < words_per_row; word++) {
+                row[word] = bitsAt(old_row, old_words_per_row, static_cast<int64_t>(word * word_bits) - offset_x);
+            }
+            row[words_per_row - 1] &= last_word_mask;
+
+            size_t first = std::max<int64_t>(0, offset_x),
+                   last = std::min<int64_t>(width, offset_x + static_cast<int64_t>(old_width));
+            if (first < last) {
+                std::copy(hues.begin() + old_y * old_width + (first - offset_x),
+                          hues.begin() + old_y * old_width + (last - offset_x),
+                          new_hues.begin() + y * width + first);
+
+                if (!decay.empty()) {
+                    std::copy(decay.begin() + old_y * old_width + (first - offset_x),
+                              decay.begin() + old_y * old_width + (last - offset_x),
+                              new_decay.begin() + y * width + first);
+                }
+            }
+        }
+
+        old_plane.assign(new_plane.size(), 0);
+        current = new_plane.data();
+        next = old_plane.data();
+        hues.swap(new_hues);
+        decay.swap(new_decay);
+        rebuildDying();
+
+        // the window grows (or shrinks) around its center, over the plane
+        if (unbounded_plane) {
+            origin_x -= offset_x;
+            origin_y -= offset_y;
+            unbounded_plane->store(current, hues.data(), grid_width, grid_height, origin_x, origin_y);
+            window_edited = false;
+        }
+
+        countPopulation();
+        last_births = last_deaths = 0;
+    }
+
+    const Grid::Word* Grid::liveness() const {
+        return current;
+    }
+
+    void Grid::updateMipmap() {
+        for (size_t tile = 0; tile < tile_unsampled.size(); tile++) {
+            tile_uncopied[tile] |= tile_unsampled[tile];
+        }
+        mipmap.update(current, words_per_row, hues.data(), tile_unsampled, *pool);
+    }
+
+    const Mipmap& Grid::getMipmap() const {
+        return mipmap;
+    }
+
+    void Grid::copyTo(Frame &frame) {
+        bool full = frame.width != grid_width || frame.height != grid_height ||
+                    frame.tile_versions.size() != tile_versions.size() || frame.decay.size() != decay.size();
+
+        frame.width = grid_width;
+        frame.height = grid_height;
+        frame.words_per_row = words_per_row;
+        frame.generation = generation_count;
+        frame.population = population_count;
+        frame.births = last_births;
+        frame.deaths = last_deaths;
+        frame.wrap = wrap;
+        frame.rule = kernel.rule;
+        frame.seed = random_seed;
+        frame.randomizations = randomizations;
+
+        if (full) {
+            frame.cells.resize(words_per_row * grid_height);
+            frame.hues.resize(hues.size());
+            frame.decay.resize(decay.size());
+            frame.tile_versions.resize(tile_versions.size());
+        }
+
+        // tiles changed (or sampled) since the last copy to any frame get a new version,
+        // the ones frame holds another version of are copied
+        copy_count++;
+        for (size_t tile = 0; tile < tile_versions.size(); tile++) {
+            if (tile_uncopied[tile] | tile_unsampled[tile]) {
+                tile_versions[tile] = copy_count;
+                tile_uncopied[tile] = 0;
+            }
+            tile_stale[tile] = full || frame.tile_versions[tile] != tile_versions[tile];
+        }
+
+        pool->run(tiles_y, [this, &frame](size_t tile_y) {
+            const uint8_t *stale = &tile_stale[tile_y * tiles_x];
+            size_t end_y = std::min(grid_height, (tile_y + 1) * tile_rows);
+
+            // runs of stale tiles along the row, [first, end)
+            for (size_t first = 0; first < tiles_x; first++) {
+                if (!stale[first]) {
+                    continue;
+                }
+
+                size_t end = first + 1;
+                while (end < tiles_x && stale[end]) {
+                    end++;
+                }
+
+                size_t first_x = first * word_bits, end_x = std::min(grid_width, end * word_bits);
+
+                for (size_t y = tile_y * tile_rows; y < end_y; y++) {
+                    std::copy(current + y * words_per_row + first, current + y * words_per_row + end,
+                              frame.cells.begin() + y * words_per_row + first);
+                    std::copy(hues.begin() + y * grid_width + first_x, hues.begin() + y * grid_width + end_x,
+                              frame.hues.begin() + y * grid_width + first_x);
+
+                    if (!decay.empty()) {
+                        std::copy(decay.begin() + y * grid_width + first_x, decay.begin() + y * grid_width + end_x,
+                                  frame.decay.begin() + y * grid_width + first_x);
+                    }
+                }
+
+                std::copy(tile_versions.begin() + tile_y * tiles_x + first, tile_versions.begin() + tile_y * tiles_x + end,
+                          frame.tile_versions.begin() + tile_y * tiles_x + first);
+                first = end;
+            }
+        });
+
+        mipmap.copyTo(frame.mipmap, tile_stale.data(), *pool);
+    }
+
+    void Grid::restore(Frame &frame) {
+        if (frame.width == 0 || frame.height == 0 ||
+            frame.cells.size() != (frame.width + word_bits - 1) / word_bits * frame.height ||
+            frame.hues.size() != frame.width * frame.height ||
+            (!frame.decay.empty() && frame.decay.size() != frame.width * frame.height)) {
+            throw std::runtime_error(std::string("Inconsistent frame for restoring grid!\n") +
+                                     "    - frame: " + std::to_string(frame.width) + "x" + std::to_string(frame.height) + "\n" +
+                                     "    - words: " + std::to_string(frame.cells.size()) + "\n" +
+                                     "    - hues: " + std::to_string(frame.hues.size()) + "\n" +
+                                     "    - decay: " + std::to_string(frame.decay.size()) + "\n");
+        }
+
+        setRule(frame.rule);
+
+        if (frame.width != grid_width || frame.height != grid_height) {
+            layout(frame.width, frame.height);
+        }
+
+        std::vector<Word> &plane = current == planes[0].data() ? planes[0] : planes[1],
+                          &other = current == planes[0].data() ? planes[1] : planes[0];
+        plane.swap(frame.cells);
+        other.assign(plane.size(), 0);
+        current = plane.data();
+        next = other.data();
+        hues.swap(frame.hues);
+        frame.tile_versions.clear();
+
+        // frames without dying states have none dying
+        if (kernel.rule.states > 2 && !frame.decay.empty()) {
+            decay.swap(frame.decay);
+        } else {
+            decay.assign(kernel.rule.states > 2 ? hues.size() : 0, 0);
+        }
+        rebuildDying();
+
+        wrap = frame.wrap;
+        random_seed = frame.seed;
+        randomizations = frame.randomizations;
+        generation_count = frame.generation;
+
+        countPopulation();
+        last_births = last_deaths = 0;
+        markAllTilesChanged();
+
+        // the plane starts over from the window
+        if (unbounded_plane) {
+            unbounded_plane->clear();
+            origin_x = origin_y = 0;
+        }
+    }
+
+    size_t Grid::activeTileCount() const {
+        return active_tiles;
+    }
+
+    size_t Grid::tileCount() const {
+        return tiles_x * tiles_y;
+    }
+}
@@ -0,0 +1,279 @@
+#ifndef GRID_H
+#define GRID_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "frame.hpp"
+#include "hashlife.h"
+#include "hue.hpp"
+#include "kernel.h"
+#include "mipmap.h"
+#include "rule.h"
+#include "thread_pool.h"
+#include "unbounded_grid.h"
+
+namespace RainbowLife {
+    // simulation state of the board, without any rendering
+    //
+    // liveness is stored as packed bits, 64 cells per word, one row after the
+    // other, with two planes: the current generation and the next one, which
+    // are swapped on every tick. a row always starts on a new word, and the
+    // unused bits at the end of a row are kept zero.
+    class Grid {
+    public:
+        typedef uint64_t Word;
+        static const size_t word_bits = 64;
+
+        // hues of randomizeHues(): a random one for every cell, smooth random
+        // regions (value noise on a lattice of noise_scale cells), or a
+        // gradient once around the hue circle, across the board in a random direction
+        enum HueField {
+            RANDOM_HUES,
+            NOISE_HUES,
+            GRADIENT_HUES
+        };
+
+        static const size_t hue_fields = 3;
+        static const size_t noise_scale = 64;
+
+        // fastForward() jumps at most 2^max_fast_forward_log2 generations
+        // (HashLife places the board on a plane of 64 bit coordinates, which
+        // has to be 8 times as wide as the jump)
+        static const unsigned max_fast_forward_log2 = 60;
+
+        // or 2^max_ticked_fast_forward_log2, where it ticks instead (a tick at a
+        // time, so a bigger jump would hold up the board for good)
+        static const unsigned max_ticked_fast_forward_log2 = 12;
+
+        // randomize() takes densities in steps of 1 / density_steps
+        static const uint32_t density_steps = 1 << 16;
+
+    private:
+        size_t grid_width, grid_height, words_per_row;
+
+        // liveness bit planes, pointed to by current and next
+        std::vector<Word> planes[2];
+        Word *current, *next;
+
+        // stands in for the rows above and below the board with dead edges
+        std::vector<Word> dead_row;
+
+        // the board is split into tiles of one word (64 cells) by 64 rows
+        // a tile is only computed if it, or one of its 8 neighbours changed in
+        // the previous tick (or was edited since), otherwise both planes
+        // already hold its next generation: it didn't change last time, and
+        // neither did anything around it
+        static const size_t tile_rows = 64;
+        size_t tiles_x, tiles_y;
+        std::vector<uint8_t> tile_changed, tile_changed_next, tile_active;
+        size_t active_tiles;
+
+        // zoomed out views, see updateMipmap()
+        // tiles changed (or with new hues) since the mipmap was last updated,
+        // over any number of ticks
+        Mipmap mipmap;
+        std::vector<uint8_t> tile_unsampled;
+
+        // see copyTo(): tiles sampled since the last copy (their flags moved
+        // over from tile_unsampled), and those stale in the frame being copied to
+        // a tile changed before a copy gets copy_count as its version
+        std::vector<uint8_t> tile_uncopied, tile_stale;
+        std::vector<uint64_t> tile_versions;
+        uint64_t copy_count;
+
+        // sets the dimensions, and sizes everything but the planes and hues to them
+        void layout(size_t width, size_t height);
+
+        void markTileChanged(size_t x, size_t y);
+        void markAllTilesChanged();
+        void findActiveTiles();
+
+        // hue of every cell, see hue.hpp
+        // there is only one plane of these: tick() writes the hue of newborn
+        // cells only, and reads the hue of living cells only, so the two never overlap
+        std::vector<Hue> hues;
+
+        // Generations rules (more than two states) only, empty otherwise:
+        // the dying state of every cell (see Frame::decay), and a bit plane
+        // of the dying cells in the layout of the liveness planes. both are
+        // updated in place by tick(), every band touching only its own rows
+        std::vector<uint8_t> decay;
+        std::vector<Word> dying;
+
+        void rebuildDying();
+
+        bool wrap;
+
+        // unbounded boards (see setUnbounded()): the cells live on unbounded_plane, the
+        // board is a window onto it, with its top left cell at origin_x, origin_y.
+        // edits go to the window, and are loaded into the plane before the next
+        // tick (window_edited), which the window then takes the changes of
+        std::unique_ptr<UnboundedGrid> unbounded_plane;
+        int64_t origin_x, origin_y;
+        bool window_edited;
+
+        void loadWindow();
+        void tickUnbounded();
+
+        // the rule, compiled for Kernel::stepRow()
+        Kernel::Compiled kernel;
+
+        // tick runs in horizontal bands of band_rows rows, one band per thread
+        // band_rows is a multiple of tile_rows, so every tile belongs to a single band
+        // (this also keeps small boards single threaded)
+        std::unique_ptr<ThreadPool> pool;
+        size_t band_rows;
+
+        void setBands();
+
+        // Larger than Life rules, per band: the living cells of every column
+        // in the rows within range of the row being computed, see tickRowsRange()
+        std::vector<std::vector<uint16_t>> band_columns;
+
+        // every random number comes from random_seed, see random.hpp
+        // randomizations counts randomize() calls, so they all differ
+        uint64_t random_seed, generation_count, randomizations;
+        uint64_t mutation_key;
+
+        // living cells, and the cells born and died in the last tick
+        // counted per band during tick(), and summed up afterwards
+        uint64_t population_count, last_births, last_deaths;
+        std::vector<uint64_t> band_births, band_deaths;
+
+        void countPopulation();
+
+        // fast forward engine, created on first use, kept for its memoised nodes
+        std::unique_ptr<HashLife> hashlife;
+
+        // mutation on cell birth
+        // (0.05 of the full circle)
+        const Hue max_cell_mutation = 3277;
+
+        Hue mutatedHue(Hue hue, size_t x, size_t y) const;
+
+        // setHue() for the ticks, which compute the window themselves: it
+        // isn't an edit, and runs in the bands (every one on its own tiles)
+        void setNewbornHue(size_t x, size_t y, Hue hue);
+
+        // hue inheritance for newborn cells, with and without wrapping/bounds checks
+        Hue inheritedHue(int x, int y) const;
+        Hue interiorInheritedHue(size_t x, size_t y) const;
+
+        // next generation of rows [begin, end), reading only the current plane
+        // births and deaths are incremented by the cells born and died there
+        void tickRows(size_t begin, size_t end, uint64_t &births, uint64_t &deaths);
+
+        // the same for Larger than Life rules, with running sums of the
+        // neighbourhood: columns down the band, then cells along every row,
+        // so a cell costs the same whatever the range
+        void tickRowsRange(size_t begin, size_t end, std::vector<uint16_t> &columns,
+                           uint64_t &births, uint64_t &deaths);
+
+        // everything after computing words [begin, end) of row y into the next
+        // plane: dying cells, changed tiles, births and deaths, and hues
+        void finishWords(size_t y, size_t begin, size_t end, uint64_t &births, uint64_t &deaths);
+
+    public:
+        // 0 threads means one per hardware thread
+        Grid(size_t width, size_t height, size_t threads = 0);
+
+        size_t width() const;
+        size_t height() const;
+
+        // changes the dimensions, keeping the cells centered (cropping them if
+        // the board shrinks), the planes keep their memory where it's big enough
+        void resize(size_t width, size_t height);
+
+        // liveness with board topology applied: coordinates are wrapped
+        // around if wrapping is enabled, otherwise cells outside are dead
+        bool alive(int x, int y) const;
+        void setAlive(size_t x, size_t y, bool alive);
+
+        // sets cells [x, x + length) of row y alive, a word at a time
+        void setAliveRun(size_t x, size_t y, size_t length);
+
+        Hue hue(size_t x, size_t y) const;
+        void setHue(size_t x, size_t y, Hue hue);
+
+        bool isWrapping() const;
+        void toggleWrap();
+
+        // unbounded, the board is a window onto a plane without edges (see
+        // UnboundedGrid), which keeps every cell that leaves it, and wrapping
+        // is ignored. the window starts at the origin of the plane, and can be
+        // moved over it; resizing keeps it centered. fast forwarding ticks, and
+        // snapshots and recordings only keep the window.
+        // Life-like rules only: enabling it throws for others, and setting
+        // one while unbounded turns it off (the window stays as the board).
+        bool isUnbounded() const;
+        void setUnbounded(bool unbounded);
+        void moveWindow(int64_t dx, int64_t dy);
+
+        // chunks of the plane in use, 0 if bounded
+        size_t chunkCount() const;
+
+        const Rule& getRule() const;
+        void setRule(const Rule &rule);
+
+        uint64_t seed() const;
+        void setSeed(uint64_t seed);
+        uint64_t generation() const;
+
+        size_t threadCount() const;
+        void setThreadCount(size_t threads);
+
+        void clear();
+
+        // fills the board with living cells at density (0 to 1), then
+        // randomizes the hues, a row of tiles per task of the pool
+        // a word of 64 cells takes as many random words as density has bits
+        // (16 at most), a vector of them at a time, see Kernel::randomRow()
+        void randomize(double density, HueField field = RANDOM_HUES);
+        void randomizeHues(HueField field = RANDOM_HUES);
+
+        void tick();
+
+        // jumps 2^log2_generations generations ahead with HashLife, log2_generations
+        // is clamped to max_fast_forward_log2
+        // (Generations and Larger than Life rules, and unbounded boards, just
+        // tick that often, clamped to max_ticked_fast_forward_log2)
+        //
+        // the jump happens on an unbounded plane: wrapping is ignored and
+        // cells leaving the board are lost. hues are approximate: survivors
+        // keep theirs, newborn cells get the average hue of the living cells
+        // that were in their tile before the jump (or of the whole board).
+        // ticks after the jump are exact again.
+        // throws if the jump runs out of HashLife nodes, the board stays as it was.
+        void fastForward(unsigned log2_generations);
+
+        uint64_t population() const;
+        uint64_t births() const;
+        uint64_t deaths() const;
+
+        // the current liveness plane, see above
+        const Word* liveness() const;
+
+        // samples the tiles changed since the last call into the mipmap
+        void updateMipmap();
+        const Mipmap& getMipmap() const;
+
+        // copies the current generation (and the mipmap, as last updated)
+        // into frame, reusing its memory, a row of tiles per task of the pool
+        // only the tiles changed since frame was last copied to are copied,
+        // see Frame::tile_versions
+        void copyTo(Frame &frame);
+
+        // takes over the whole state of frame, dimensions included, its
+        // liveness and hues are swapped in, not copied
+        void restore(Frame &frame);
+
+        // tiles computed in the last tick, out of tileCount()
+        // (unbounded, the chunks computed, which can be more)
+        size_t activeTileCount() const;
+        size_t tileCount() const;
+    };
+}
+
+#endif /* GRID_H */
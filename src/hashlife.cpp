@@ -0,0 +1,368 @@
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include "hashlife.h"
+#include "random.hpp"
+
+namespace RainbowLife {
+
+    const HashLife::NodeId HashLife::no_node;
+    const HashLife::NodeId HashLife::dead_leaf;
+    const HashLife::NodeId HashLife::alive_leaf;
+
+    HashLife::HashLife(const Rule &rule, size_t max_nodes) :
+        max_nodes(max_nodes),
+        table_used(0),
+        root(dead_leaf),
+        rule(rule),
+        board_x(0),
+        board_y(0)
+    {
+        reset();
+    }
+
+    void HashLife::reset() {
+        nodes.clear();
+        nodes.push_back(Node{no_node, no_node, no_node, no_node, no_node, 0, 0, 0});
+        nodes.push_back(Node{no_node, no_node, no_node, no_node, no_node, 0, 0, 1});
+
+        empty_nodes.assign(1, dead_leaf);
+        rehash(1024);
+        root = dead_leaf;
+    }
+
+    size_t HashLife::hash(NodeId nw, NodeId ne, NodeId sw, NodeId se) {
+        return Random::mix(Random::mix((uint64_t(nw) << 32) | ne) ^ ((uint64_t(sw) << 32) | se));
+    }
+
+    void HashLife::rehash(size_t capacity) {
+        table.assign(capacity, no_node);
+        table_used = 0;
+
+        // leaves are not in the table, they have no children
+        for (NodeId id = 2; id < nodes.size(); id++) {
+            const Node &node = nodes[id];
+            size_t i = hash(node.nw, node.ne, node.sw, node.se) & (capacity - 1);
+            while (table[i] != no_node) {
+                i = (i + 1) & (capacity - 1);
+            }
+            table[i] = id;
+            table_used++;
+        }
+    }
+
+    HashLife::NodeId HashLife::join(NodeId nw, NodeId ne, NodeId sw, NodeId se) {
+        size_t mask = table.size() - 1,
+               i = hash(nw, ne, sw, se) & mask;
+
+        while (table[i] != no_node) {
+            const Node &node = nodes[table[i]];
+            if (node.nw == nw && node.ne == ne && node.sw == sw && node.se == se) {
+                return table[i];
+            }
+            i = (i + 1) & mask;
+        }
+
+        if (nodes.size() >= no_node) {
+            throw std::runtime_error(std::string("Out of HashLife nodes!\n") +
+                                     "    - nodes: " + std::to_string(nodes.size()) + "\n");
+        }
+
+        NodeId id = nodes.size();
+        nodes.push_back(Node{nw, ne, sw, se, no_node, 0,
+                             static_cast<uint8_t>(nodes[nw].level + 1),
+                             nodes[nw].population + nodes[ne].population + nodes[sw].population + nodes[se].population});
+        table[i] = id;
+        table_used++;
+
+        // keeping the table at most half full
+        if (table_used * 2 > table.size()) {
+            rehash(table.size() * 2);
+        }
+
+        return id;
+    }
+
+    HashLife::NodeId HashLife::empty(unsigned level) {
+        while (empty_nodes.size() <= level) {
+            NodeId below = empty_nodes.back();
+            empty_nodes.push_back(join(below, below, below, below));
+        }
+        return empty_nodes[level];
+    }
+
+    // same node, one level bigger, with empty space around it
+    HashLife::NodeId HashLife::centre(NodeId id) {
+        Node node = nodes[id];
+        NodeId border = empty(node.level - 1);
+
+        return join(join(border, border, border, node.nw),
+                    join(border, border, node.ne, border),
+                    join(border, node.sw, border, border),
+                    join(node.se, border, border, border));
+    }
+
+    // true if every living cell is within the central quarter of the node
+    bool HashLife::isPadded(NodeId id) const {
+        const Node &node = nodes[id];
+        if (node.level < 2) {
+            return node.population == 0;
+        }
+
+        return node.population == nodes[nodes[node.nw].se].population +
+                                  nodes[nodes[node.ne].sw].population +
+                                  nodes[nodes[node.sw].ne].population +
+                                  nodes[nodes[node.se].nw].population;
+    }
+
+    // the central 2x2 cells of a 4x4 node, one generation later
+    HashLife::NodeId HashLife::life4x4(NodeId id) {
+        const Node &node = nodes[id];
+
+        // the 16 cells, bit y * 4 + x
+        unsigned cells = 0;
+        const NodeId quadrants[4] = { node.nw, node.ne, node.sw, node.se };
+        for (unsigned q = 0; q < 4; q++) {
+            const Node &quadrant = nodes[quadrants[q]];
+            unsigned x = (q % 2) * 2,
+                     y = (q / 2) * 2;
+
+            cells |= (quadrant.nw == alive_leaf) << (y * 4 + x);
+            cells |= (quadrant.ne == alive_leaf) << (y * 4 + x + 1);
+            cells |= (quadrant.sw == alive_leaf) << ((y + 1) * 4 + x);
+            cells |= (quadrant.se == alive_leaf) << ((y + 1) * 4 + x + 1);
+        }
+
+        NodeId next[4];
+        for (unsigned c = 0; c < 4; c++) {
+            unsigned x = 1 + c % 2,
+                     y = 1 + c / 2,
+                     neighbours_alive = 0;
+
+            for (unsigned ny = y - 1; ny <= y + 1; ny++) {
+                for (unsigned nx = x - 1; nx <= x + 1; nx++) {
+                    if (nx != x || ny != y) {
+                        neighbours_alive += (cells >> (ny * 4 + nx)) & 1;
+                    }
+                }
+            }
+
+            bool alive = (cells >> (y * 4 + x)) & 1;
+            next[c] = rule.next(alive, neighbours_alive) ? alive_leaf : dead_leaf;
+        }
+
+        return join(next[0], next[1], next[2], next[3]);
+    }
+
+    // the central half of a node, 2^step generations later
+    // (step is capped at level - 2, the furthest a node can see)
+    HashLife::NodeId HashLife::successor(NodeId id, unsigned step) {
+        const Node node = nodes[id];
+
+        if (node.population == 0) {
+            return node.nw;
+        }
+
+        step = std::min(step, static_cast<unsigned>(node.level - 2));
+
+        if (node.result != no_node && node.result_step == step) {
+            return node.result;
+        }
+
+        NodeId result;
+
+        if (node.level == 2) {
+            result = life4x4(id);
+        } else {
+            // the 16 grandchildren (copied, joins below may move nodes around)
+            const Node a = nodes[node.nw], b = nodes[node.ne],
+                       c = nodes[node.sw], d = nodes[node.se];
+
+            // the 9 overlapping sub-squares of half size, advanced
+            NodeId c1 = successor(node.nw, step),
+                   c2 = successor(join(a.ne, b.nw, a.se, b.sw), step),
+                   c3 = successor(node.ne, step),
+                   c4 = successor(join(a.sw, a.se, c.nw, c.ne), step),
+                   c5 = successor(join(a.se, b.sw, c.ne, d.nw), step),
+                   c6 = successor(join(b.sw, b.se, d.nw, d.ne), step),
+                   c7 = successor(node.sw, step),
+                   c8 = successor(join(c.ne, d.nw, c.se, d.sw), step),
+                   c9 = successor(node.se, step);
+
+            if (step < node.level - 2u) {
+                // advanced enough already, just the centre of them is needed
+                const Node n1 = nodes[c1], n2 = nodes[c2], n3 = nodes[c3],
+                           n4 = nodes[c4], n5 = nodes[c5], n6 = nodes[c6],
+                           n7 = nodes[c7], n8 = nodes[c8], n9 = nodes[c9];
+
+                NodeId nw = join(n1.se, n2.sw, n4.ne, n5.nw),
+                       ne = join(n2.se, n3.sw, n5.ne, n6.nw),
+                       sw = join(n4.se, n5.sw, n7.ne, n8.nw),
+                       se = join(n5.se, n6.sw, n8.ne, n9.nw);
+                result = join(nw, ne, sw, se);
+            } else {
+                // full speed: a second round of successors on their 4 combinations
+                NodeId nw = successor(join(c1, c2, c4, c5), step),
+                       ne = successor(join(c2, c3, c5, c6), step),
+                       sw = successor(join(c4, c5, c7, c8), step),
+                       se = successor(join(c5, c6, c8, c9), step);
+                result = join(nw, ne, sw, se);
+            }
+        }
+
+        nodes[id].result = result;
+        nodes[id].result_step = step;
+
+        return result;
+    }
+
+    HashLife::NodeId HashLife::build(const Word *plane, size_t width, size_t height, size_t words_per_row,
+                                     unsigned level, int64_t x, int64_t y) {
+        // board coordinates of the square
+        int64_t left = x - board_x,
+                top = y - board_y,
+                size = int64_t(1) << level;
+
+        if (left >= static_cast<int64_t>(width) || top >= static_cast<int64_t>(height) || left + size <= 0 || top + size <= 0) {
+            return empty(level);
+        }
+
+        if (level == 0) {
+            return (plane[top * words_per_row + left / 64] >> (left % 64)) & 1 ? alive_leaf : dead_leaf;
+        }
+
+        // word sized squares are skipped right away if empty
+        if (level == 6 && left >= 0 && top >= 0) {
+            Word any = 0;
+            for (int64_t row = top; row < top + size && row < static_cast<int64_t>(height); row++) {
+                any |= plane[row * words_per_row + left / 64];
+            }
+            if (any == 0) {
+                return empty(level);
+            }
+        }
+
+        int64_t half = size / 2;
+        NodeId nw = build(plane, width, height, words_per_row, level - 1, x, y),
+               ne = build(plane, width, height, words_per_row, level - 1, x + half, y),
+               sw = build(plane, width, height, words_per_row, level - 1, x, y + half),
+               se = build(plane, width, height, words_per_row, level - 1, x + half, y + half);
+
+        return join(nw, ne, sw, se);
+    }
+
+    void HashLife::load(const Word *plane, size_t width, size_t height, size_t words_per_row) {
+        unsigned level = 6;
+        while ((size_t(1) << level) < std::max(width, height)) {
+            level++;
+        }
+
+        // the board sits in the top left corner of the root (root is centred on 0, 0)
+        board_x = board_y = -(int64_t(1) << (level - 1));
+        root = build(plane, width, height, words_per_row, level, board_x, board_y);
+
+        if (nodes.size() > max_nodes) {
+            collectGarbage();
+        }
+    }
+
+    void HashLife::store(NodeId id, Word *plane, size_t width, size_t height, size_t words_per_row,
+                         int64_t x, int64_t y) const {
+        const Node &node = nodes[id];
+        int64_t left = x - board_x,
+                top = y - board_y,
+                size = int64_t(1) << node.level;
+
+        if (node.population == 0 ||
+            left >= static_cast<int64_t>(width) || top >= static_cast<int64_t>(height) || left + size <= 0 || top + size <= 0) {
+            return;
+        }
+
+        if (node.level == 0) {
+            plane[top * words_per_row + left / 64] |= Word(1) << (left % 64);
+            return;
+        }
+
+        int64_t half = size / 2;
+        store(node.nw, plane, width, height, words_per_row, x, y);
+        store(node.ne, plane, width, height, words_per_row, x + half, y);
+        store(node.sw, plane, width, height, words_per_row, x, y + half);
+        store(node.se, plane, width, height, words_per_row, x + half, y + half);
+    }
+
+    void HashLife::store(Word *plane, size_t width, size_t height, size_t words_per_row) const {
+        std::fill(plane, plane + words_per_row * height, 0);
+
+        int64_t half = int64_t(1) << (nodes[root].level - 1);
+        store(root, plane, width, height, words_per_row, -half, -half);
+    }
+
+    void HashLife::step(unsigned log2_generations) {
+        // the living cells must stay within the central quarter, and the root
+        // must be big enough to see 2^log2_generations ahead with room to
+        // spare: in 2^(level-3) generations, nothing can leave the central half,
+        // even at the speed of light
+        while (nodes[root].level < log2_generations + 3 || !isPadded(root)) {
+            root = centre(root);
+        }
+
+        root = successor(root, log2_generations);
+
+        if (nodes.size() > max_nodes) {
+            collectGarbage();
+        }
+    }
+
+    HashLife::NodeId HashLife::copyReachable(NodeId id, std::vector<Node> &kept, std::vector<NodeId> &remap) const {
+        if (remap[id] != no_node) {
+            return remap[id];
+        }
+
+        Node node = nodes[id];
+        node.nw = copyReachable(node.nw, kept, remap);
+        node.ne = copyReachable(node.ne, kept, remap);
+        node.sw = copyReachable(node.sw, kept, remap);
+        node.se = copyReachable(node.se, kept, remap);
+        node.result = no_node;
+
+        remap[id] = kept.size();
+        kept.push_back(node);
+        return remap[id];
+    }
+
+    void HashLife::collectGarbage() {
+        std::vector<NodeId> remap(nodes.size(), no_node);
+        std::vector<Node> kept;
+        kept.reserve(nodes.size() / 2);
+
+        kept.push_back(nodes[dead_leaf]);
+        kept.push_back(nodes[alive_leaf]);
+        remap[dead_leaf] = dead_leaf;
+        remap[alive_leaf] = alive_leaf;
+
+        if (root != dead_leaf && root != alive_leaf) {
+            root = copyReachable(root, kept, remap);
+        }
+
+        nodes.swap(kept);
+        empty_nodes.assign(1, dead_leaf);
+
+        size_t capacity = 1024;
+        while (capacity < nodes.size() * 2) {
+            capacity *= 2;
+        }
+        rehash(capacity);
+    }
+
+    const Rule& HashLife::getRule() const {
+        return rule;
+    }
+
+    uint64_t HashLife::population() const {
+        return nodes[root].population;
+    }
+
+    size_t HashLife::nodeCount() const {
+        return nodes.size();
+    }
+}
@@ -0,0 +1,101 @@
+#ifndef HASHLIFE_H
+#define HASHLIFE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "rule.h"
+
+namespace RainbowLife {
+    // HashLife engine, for jumping ahead 2^k generations at once
+    //
+    // the universe is a quadtree of canonical nodes: equal subtrees are stored
+    // once (found through a hash table), and every node memoises its own
+    // future, so repeating structures in space and time are only computed
+    // once. it works on the unbounded plane, liveness only (no hues), with
+    // any Life-like rule without B0 (so empty space stays empty).
+    //
+    // the node store is bounded between steps: when it grows past max_nodes,
+    // everything not reachable from the current universe is garbage collected
+    // (with the memoised results, which are then recomputed on demand). a
+    // single step is not interrupted, so it can take as many nodes as the
+    // jump needs: chaotic patterns over large jumps can exhaust memory (or
+    // the 2^32 node ids, which step() throws for).
+    class HashLife {
+    public:
+        typedef uint64_t Word;
+        typedef uint32_t NodeId;
+
+    private:
+        struct Node {
+            NodeId nw, ne, sw, se;
+
+            // memoised successor, advanced 2^result_step generations
+            NodeId result;
+            uint8_t result_step;
+
+            uint8_t level;
+            uint64_t population;
+        };
+
+        static const NodeId no_node = 0xFFFFFFFFu;
+        static const NodeId dead_leaf = 0, alive_leaf = 1;
+
+        std::vector<Node> nodes;
+        size_t max_nodes;
+
+        // open addressing hash table of node ids, keyed by their children
+        std::vector<NodeId> table;
+        size_t table_used;
+
+        // canonical empty node of every level
+        std::vector<NodeId> empty_nodes;
+
+        // the universe: root spans [-2^(level-1), 2^(level-1)) on both axes
+        NodeId root;
+
+        Rule rule;
+
+        // plane coordinates of cell (0, 0) of the board loaded last
+        int64_t board_x, board_y;
+
+        static size_t hash(NodeId nw, NodeId ne, NodeId sw, NodeId se);
+        void rehash(size_t capacity);
+        NodeId join(NodeId nw, NodeId ne, NodeId sw, NodeId se);
+        NodeId empty(unsigned level);
+        NodeId centre(NodeId id);
+        bool isPadded(NodeId id) const;
+
+        NodeId life4x4(NodeId id);
+        NodeId successor(NodeId id, unsigned step);
+
+        NodeId build(const Word *plane, size_t width, size_t height, size_t words_per_row,
+                     unsigned level, int64_t x, int64_t y);
+        void store(NodeId id, Word *plane, size_t width, size_t height, size_t words_per_row,
+                   int64_t x, int64_t y) const;
+
+        NodeId copyReachable(NodeId id, std::vector<Node> &kept, std::vector<NodeId> &remap) const;
+        void collectGarbage();
+        void reset();
+
+    public:
+        HashLife(const Rule &rule = Rule::life(), size_t max_nodes = size_t(1) << 22);
+
+        const Rule& getRule() const;
+
+        // replaces the universe with a board in the bit plane layout of Grid
+        void load(const Word *plane, size_t width, size_t height, size_t words_per_row);
+
+        // writes the part of the universe covering the loaded board into a
+        // bit plane, the rest of the universe is cut off
+        void store(Word *plane, size_t width, size_t height, size_t words_per_row) const;
+
+        // advances the universe by 2^log2_generations generations
+        void step(unsigned log2_generations);
+
+        uint64_t population() const;
+        size_t nodeCount() const;
+    };
+}
+
+#endif /* HASHLIFE_H */
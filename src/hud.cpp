@@ -0,0 +1,147 @@
+#include <algorithm>
+#include "hud.h"
+#include "log.hpp"
+
+namespace RainbowLife {
+
+    namespace {
+        const int margin = 8;
+    }
+
+    Hud::Hud(const std::string &font_path, size_t columns, size_t lines, int font_size, SDL_Renderer *renderer) :
+        font(nullptr),
+        panel(nullptr),
+        texture(nullptr),
+        line_height(0),
+        area{margin, margin, 0, 0},
+        visible{false}
+    {
+        font = TTF_OpenFont(font_path.c_str(), font_size);
+
+        if (font == nullptr) {
+            log("HUD disabled, unable to open font ", font_path, ": ", TTF_GetError());
+            return;
+        }
+
+        const SDL_Color white = { 255, 255, 255, 255 };
+        line_height = TTF_FontHeight(font);
+
+        int widest = 0;
+        for (char character = first_glyph; character <= last_glyph; character++) {
+            const char text[2] = { character, '\0' };
+            glyphs.push_back(TTF_RenderUTF8_Blended(font, text, white));
+
+            if (glyphs.back() != nullptr && glyphs.back()->w > widest) {
+                widest = glyphs.back()->w;
+            }
+        }
+
+        panel = SDL_CreateRGBSurfaceWithFormat(0, widest * static_cast<int>(columns) + 2 * margin,
+                                               line_height * static_cast<int>(lines) + 2 * margin,
+                                               32, SDL_PIXELFORMAT_ARGB8888);
+
+        if (panel != nullptr && renderer != nullptr) {
+            texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, panel->w, panel->h);
+        }
+    }
+
+    Hud::~Hud() {
+        for (SDL_Surface *glyph : glyphs) {
+            if (glyph != nullptr) {
+                SDL_FreeSurface(glyph);
+            }
+        }
+
+        if (texture != nullptr) {
+            SDL_DestroyTexture(texture);
+        }
+
+        if (panel != nullptr) {
+            SDL_FreeSurface(panel);
+        }
+
+        if (font != nullptr) {
+            TTF_CloseFont(font);
+        }
+    }
+
+    bool Hud::isAvailable() const {
+        return font != nullptr;
+    }
+
+    bool Hud::isVisible() const {
+        return visible;
+    }
+
+    void Hud::toggle() {
+        visible = isAvailable() && !visible;
+    }
+
+    SDL_Surface* Hud::glyph(char character) const {
+        if (character < first_glyph || character > last_glyph) {
+            return nullptr;
+        }
+        return glyphs[character - first_glyph];
+    }
+
+    void Hud::update(const std::vector<std::string> &lines) {
+        if (panel == nullptr) {
+            return;
+        }
+
+        int width = 0, height = 0;
+
+        for (const std::string &line : lines) {
+            int line_width = 0;
+            for (char character : line) {
+                SDL_Surface *text = glyph(character);
+                line_width += text != nullptr ? text->w : 0;
+            }
+
+            width = line_width > width ? line_width : width;
+            height += line_height;
+        }
+
+        // the area only grows, cut off at the panel
+        area.w = std::min(std::max(area.w, width + 2 * margin), panel->w);
+        area.h = std::min(std::max(area.h, height + 2 * margin), panel->h);
+
+        SDL_Rect shown = { 0, 0, area.w, area.h };
+        SDL_FillRect(panel, &shown, SDL_MapRGB(panel->format, 0, 0, 0));
+
+        int y = margin;
+        for (const std::string &line : lines) {
+            SDL_Rect position = { margin, y, 0, 0 };
+
+            for (char character : line) {
+                SDL_Surface *text = glyph(character);
+
+                if (text != nullptr) {
+                    SDL_Rect destination = position;
+                    SDL_BlitSurface(text, NULL, panel, &destination);
+                    position.x += text->w;
+                }
+            }
+            y += line_height;
+        }
+
+        if (texture != nullptr) {
+            SDL_UpdateTexture(texture, &shown, panel->pixels, panel->pitch);
+        }
+    }
+
+    const SDL_Rect& Hud::getArea() const {
+        return area;
+    }
+
+    void Hud::draw(SDL_Surface *surface) {
+        if (panel != nullptr) {
+            SDL_Rect shown = { 0, 0, area.w, area.h }, position = area;
+            SDL_BlitSurface(panel, &shown, surface, &position);
+        }
+    }
+
+    SDL_Texture* Hud::getTexture() const {
+        return texture;
+    }
+};
@@ -0,0 +1,66 @@
+#ifndef HUD_H
+#define HUD_H
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+#include <string>
+#include <vector>
+
+namespace RainbowLife {
+    // on-screen overlay with a few lines of text, in the top left corner
+    //
+    // the panel is opaque, so drawing it again over itself changes nothing:
+    // it only has to be drawn when its text or the cells under it changed.
+    // without its font, the HUD is unavailable and stays hidden.
+    //
+    // text is drawn a glyph at a time (printable ASCII only, without
+    // kerning), from glyphs rendered once by the constructor, so update()
+    // doesn't call into SDL_ttf. the panel (and its texture) is made once
+    // too, for the most lines and columns the text can have (more is cut
+    // off), and only its top left part is shown: the area of the largest text
+    // so far, so it grows with the text but never leaves stale pixels behind.
+    class Hud {
+    private:
+        TTF_Font *font;
+
+        // made by the constructor, nullptr without font (and the texture
+        // without renderer, for windows in TEXTURE mode only)
+        SDL_Surface *panel;
+        SDL_Texture *texture;
+
+        // glyphs[c - first_glyph] is character c (nullptr if the font has
+        // none), as wide as it moves the pen, and line_height high
+        static const char first_glyph = ' ', last_glyph = '~';
+        std::vector<SDL_Surface*> glyphs;
+        int line_height;
+
+        // nullptr for characters without a glyph
+        SDL_Surface* glyph(char character) const;
+
+        SDL_Rect area;
+        bool visible;
+
+    public:
+        // columns are counted in the widest glyph of the font
+        Hud(const std::string &font_path, size_t columns, size_t lines, int font_size = 16,
+            SDL_Renderer *renderer = nullptr);
+        ~Hud();
+
+        Hud(const Hud&) = delete;
+        Hud& operator=(const Hud&) = delete;
+
+        bool isAvailable() const;
+        bool isVisible() const;
+        void toggle();
+
+        void update(const std::vector<std::string> &lines);
+
+        // where the panel is drawn (from its top left corner), empty before the first update()
+        const SDL_Rect& getArea() const;
+
+        void draw(SDL_Surface *surface);
+        SDL_Texture* getTexture() const;
+    };
+}
+
+#endif /* HUD_H */
@@ -0,0 +1,20 @@
+#ifndef HUE_HPP
+#define HUE_HPP
+
+#include <cstdint>
+
+// hue as a fixed point angle: the full circle is 65536, so it wraps around
+// on its own with unsigned 16 bit arithmetic (65536 = 0 = 360 degrees)
+typedef uint16_t Hue;
+
+const uint32_t hue_circle = 65536;
+
+// average of two hues, along the shorter arc between them
+// the signed difference is the shorter way from hue1 to hue2, halving it
+// gives the midpoint, no matter where the two are on the circle
+inline Hue average_hue(Hue hue1, Hue hue2)
+{
+    return hue1 + static_cast<int16_t>(hue2 - hue1) / 2;
+}
+
+#endif /* HUE_HPP */
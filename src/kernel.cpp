@@ -0,0 +1,434 @@
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "kernel.h"
+#include "random.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define RAINBOW_LIFE_X86_DISPATCH
+
+    // the vector helpers are always inlined into their AVX callers, so their
+    // (never used) out-of-line calling convention is irrelevant
+    #pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+namespace RainbowLife {
+    namespace Kernel {
+
+        namespace {
+            const size_t word_bits = 64;
+
+            #define KERNEL_INLINE inline __attribute__((always_inline))
+
+            // living neighbours of every cell of a word (or vector of words), bit by bit
+            template <typename V>
+            struct Counts {
+                V ones, twos, fours, eights;
+            };
+
+            // from the words of the three rows and their west/east shifted copies
+            // (west holds the west neighbour of each cell in the cell's own bit)
+            template <typename V>
+            KERNEL_INLINE Counts<V> countNeighbours(const V &above_west, const V &above, const V &above_east,
+                                                    const V &west, const V &east,
+                                                    const V &below_west, const V &below, const V &below_east) {
+                // full adders on the rows above and below, half adder on the middle row
+                V above_ones = above_west ^ above ^ above_east,
+                  above_twos = (above_west & above) | (above_east & (above_west ^ above)),
+                  below_ones = below_west ^ below ^ below_east,
+                  below_twos = (below_west & below) | (below_east & (below_west ^ below)),
+                  middle_ones = west ^ east,
+                  middle_twos = west & east;
+
+                // adding up the ones, carry goes to the twos
+                V ones = above_ones ^ below_ones ^ middle_ones,
+                  ones_carry = (above_ones & below_ones) | (middle_ones & (above_ones ^ below_ones));
+
+                // adding up the twos, carries go to the fours
+                V twos_partial = above_twos ^ below_twos ^ middle_twos,
+                  twos_carry = (above_twos & below_twos) | (middle_twos & (above_twos ^ below_twos)),
+                  fours_carry = twos_partial & ones_carry;
+
+                // both carries only with all 8 neighbours alive
+                return { ones, twos_partial ^ ones_carry, twos_carry ^ fours_carry, twos_carry & fours_carry };
+            }
+
+            // if_set where condition is, if_clear elsewhere (constant sides fold away)
+            template <typename V>
+            KERNEL_INLINE V select(const V &condition, const V &if_set, const V &if_clear) {
+                return if_clear ^ ((if_set ^ if_clear) & condition);
+            }
+
+            // cells with a count of 2 * pair or 2 * pair + 1 in counts, told apart by the ones bit
+            template <typename V>
+            KERNEL_INLINE V pairIn(const Counts<V> &neighbours, unsigned counts, unsigned pair) {
+                bool even = (counts >> (2 * pair)) & 1,
+                     odd = (counts >> (2 * pair + 1)) & 1;
+                V none = neighbours.ones ^ neighbours.ones;
+
+                return even ? (odd ? ~none : ~neighbours.ones) : (odd ? neighbours.ones : none);
+            }
+
+            // cells with a neighbour count in counts (bit n for n neighbours)
+            // counts is a constant once inlined, so this is a mux tree on the
+            // count bits of which only the branches it needs are left
+            template <typename V>
+            KERNEL_INLINE V countIn(const Counts<V> &neighbours, unsigned counts) {
+                V match = select(neighbours.fours,
+                                 select(neighbours.twos, pairIn(neighbours, counts, 3), pairIn(neighbours, counts, 2)),
+                                 select(neighbours.twos, pairIn(neighbours, counts, 1), pairIn(neighbours, counts, 0)));
+
+                // 8 has the same low bits as 0
+                bool zero = counts & 1,
+                     eight = (counts >> 8) & 1;
+                if (zero && !eight) {
+                    match = match & ~neighbours.eights;
+                } else if (eight && !zero) {
+                    match = match | neighbours.eights;
+                }
+
+                return match;
+            }
+
+            // the rule, as the network below sees it: a FixedRule is a
+            // compile time constant, so every branch on it folds away and
+            // only the terms of its counts are left
+            template <uint16_t Birth, uint16_t Survival>
+            struct FixedRule {
+                FixedRule(const Rule &) {}
+                uint16_t birth() const { return Birth; }
+                uint16_t survival() const { return Survival; }
+            };
+
+            struct GenericRule {
+                Rule rule;
+                GenericRule(const Rule &rule) : rule(rule) {}
+                uint16_t birth() const { return rule.birth; }
+                uint16_t survival() const { return rule.survival; }
+            };
+
+            // next state of every cell in a word (or vector of words), see countNeighbours()
+            template <typename V, typename R>
+            KERNEL_INLINE V ruleWord(const R &rule,
+                                     const V &above_west, const V &above, const V &above_east,
+                                     const V &west, const V &alive, const V &east,
+                                     const V &below_west, const V &below, const V &below_east) {
+                Counts<V> counts = countNeighbours<V>(above_west, above, above_east, west, east, below_west, below, below_east);
+
+                return select(alive, countIn(counts, rule.survival()), countIn(counts, rule.birth()));
+            }
+
+            template <typename V>
+            KERNEL_INLINE V load(const Word *source) {
+                V value;
+                memcpy(&value, source, sizeof(V));
+                return value;
+            }
+
+            template <typename V>
+            KERNEL_INLINE void store(Word *destination, const V &value) {
+                memcpy(destination, &value, sizeof(V));
+            }
+
+            template <typename V>
+            KERNEL_INLINE V westOf(const Word *row, size_t i) {
+                return (load<V>(row + i) << 1) | (load<V>(row + i - 1) >> (word_bits - 1));
+            }
+
+            template <typename V>
+            KERNEL_INLINE V eastOf(const Word *row, size_t i) {
+                return (load<V>(row + i) >> 1) | (load<V>(row + i + 1) << (word_bits - 1));
+            }
+
+            // words [begin, end) of a row, all of which have both horizontal neighbour words
+            template <typename V, typename R>
+            KERNEL_INLINE void stepWords(const R &rule, const Word *above, const Word *row, const Word *below, Word *next_row, size_t begin, size_t end) {
+                const size_t lanes = sizeof(V) / sizeof(Word);
+
+                size_t i = begin;
+                for (; i + lanes <= end; i += lanes) {
+                    store<V>(next_row + i, ruleWord<V>(rule,
+                                                       westOf<V>(above, i), load<V>(above + i), eastOf<V>(above, i),
+                                                       westOf<V>(row, i), load<V>(row + i), eastOf<V>(row, i),
+                                                       westOf<V>(below, i), load<V>(below + i), eastOf<V>(below, i)));
+                }
+                for (; i < end; i++) {
+                    next_row[i] = ruleWord<Word>(rule,
+                                                 westOf<Word>(above, i), above[i], eastOf<Word>(above, i),
+                                                 westOf<Word>(row, i), row[i], eastOf<Word>(row, i),
+                                                 westOf<Word>(below, i), below[i], eastOf<Word>(below, i));
+                }
+            }
+
+            // Random::mix() of every lane
+            // (taken by reference: the note on passing 64 byte vectors by value
+            // isn't a warning, so the pragma above doesn't silence it)
+            template <typename V>
+            KERNEL_INLINE V mixLanes(const V &lanes) {
+                V value = lanes + 0x9E3779B97F4A7C15ull;
+                value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+                value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+                return value ^ (value >> 31);
+            }
+
+            // Random::cell() of x to x + lanes - 1, a lane each
+            const Word lane_offsets[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+
+            template <typename V>
+            KERNEL_INLINE V randomLanes(uint64_t key, uint64_t x, uint64_t y) {
+                V xs = load<V>(lane_offsets) + x;
+                return mixLanes<V>(((xs << 32) | (y & 0xFFFFFFFFull)) ^ key);
+            }
+
+            // word i of row y of a random fill (and the ones after it, a lane each), see Kernel::randomRow()
+            template <typename V>
+            KERNEL_INLINE V randomCells(uint64_t key, size_t y, uint32_t steps, unsigned bits, size_t words, size_t i) {
+                V cells = steps >> bits ? ~V() : V();
+
+                for (unsigned bit = steps ? __builtin_ctz(steps) : bits; bit < bits; bit++) {
+                    V random = randomLanes<V>(key, bit * words + i, y);
+                    cells = (steps >> bit) & 1 ? cells | random : cells & random;
+                }
+                return cells;
+            }
+
+            template <typename V>
+            KERNEL_INLINE void randomWords(uint64_t key, size_t y, uint32_t steps, unsigned bits, Word *row, size_t words) {
+                const size_t lanes = sizeof(V) / sizeof(Word);
+
+                size_t i = 0;
+                for (; i + lanes <= words; i += lanes) {
+                    store(row + i, randomCells<V>(key, y, steps, bits, words, i));
+                }
+                for (; i < words; i++) {
+                    row[i] = randomCells<Word>(key, y, steps, bits, words, i);
+                }
+            }
+
+            // see Kernel::randomHues(), the lanes are copied out as they are (little endian)
+            template <typename V>
+            KERNEL_INLINE void randomHueLanes(uint64_t key, size_t y, Hue *hues, size_t width) {
+                const size_t lanes = sizeof(V) / sizeof(Word);
+
+                size_t i = 0;
+                for (; (i + lanes) * 4 <= width; i += lanes) {
+                    V random = randomLanes<V>(key, i, y);
+                    memcpy(hues + i * 4, &random, sizeof(V));
+                }
+
+                for (; i * 4 < width; i++) {
+                    Word random = Random::cell(key, i, y);
+                    for (size_t x = i * 4; x < width && x < i * 4 + 4; x++, random >>= 16) {
+                        hues[x] = static_cast<Hue>(random);
+                    }
+                }
+            }
+
+            template <typename R>
+            void stepWordsScalar(const Rule &rule, const Word *above, const Word *row, const Word *below, Word *next_row, size_t begin, size_t end) {
+                stepWords<Word>(R(rule), above, row, below, next_row, begin, end);
+            }
+
+#ifdef RAINBOW_LIFE_X86_DISPATCH
+            typedef Word Word4 __attribute__((vector_size(32)));
+            typedef Word Word8 __attribute__((vector_size(64)));
+
+            template <typename R>
+            __attribute__((target("avx2")))
+            void stepWordsAvx2(const Rule &rule, const Word *above, const Word *row, const Word *below, Word *next_row, size_t begin, size_t end) {
+                stepWords<Word4>(R(rule), above, row, below, next_row, begin, end);
+            }
+
+            template <typename R>
+            __attribute__((target("avx512f")))
+            void stepWordsAvx512(const Rule &rule, const Word *above, const Word *row, const Word *below, Word *next_row, size_t begin, size_t end) {
+                stepWords<Word8>(R(rule), above, row, below, next_row, begin, end);
+            }
+
+            __attribute__((target("avx2")))
+            void randomWordsAvx2(uint64_t key, size_t y, uint32_t steps, unsigned bits, Word *row, size_t words) {
+                randomWords<Word4>(key, y, steps, bits, row, words);
+            }
+
+            __attribute__((target("avx512f")))
+            void randomWordsAvx512(uint64_t key, size_t y, uint32_t steps, unsigned bits, Word *row, size_t words) {
+                randomWords<Word8>(key, y, steps, bits, row, words);
+            }
+
+            __attribute__((target("avx2")))
+            void randomHuesAvx2(uint64_t key, size_t y, Hue *hues, size_t width) {
+                randomHueLanes<Word4>(key, y, hues, width);
+            }
+
+            __attribute__((target("avx512f")))
+            void randomHuesAvx512(uint64_t key, size_t y, Hue *hues, size_t width) {
+                randomHueLanes<Word8>(key, y, hues, width);
+            }
+#endif
+
+            enum InstructionSet {
+                SCALAR,
+                AVX2,
+                AVX512
+            };
+
+            struct Dispatch {
+                InstructionSet set;
+                const char *name;
+            };
+
+            // picks the widest supported instruction set, unless
+            // RAINBOW_LIFE_KERNEL is set to "scalar", "avx2" or "avx512"
+            Dispatch selectDispatch() {
+                const char *requested = getenv("RAINBOW_LIFE_KERNEL");
+                std::string wanted = requested ? requested : "";
+
+#ifdef RAINBOW_LIFE_X86_DISPATCH
+                __builtin_cpu_init();
+
+                if ((wanted.empty() || wanted == "avx512") && __builtin_cpu_supports("avx512f")) {
+                    return { AVX512, "avx512" };
+                }
+                if ((wanted.empty() || wanted == "avx2" || wanted == "avx512") && __builtin_cpu_supports("avx2")) {
+                    return { AVX2, "avx2" };
+                }
+#endif
+
+                return { SCALAR, "scalar" };
+            }
+
+            const Dispatch dispatch = selectDispatch();
+
+            // a word on either end of a row: its horizontal neighbour bits
+            // come from the other end of the row if wrapping, or are dead
+            template <typename R>
+            Word stepEdgeWord(const Rule &rule, const Word *above, const Word *row, const Word *below, size_t i, size_t width, bool wrap) {
+                const size_t words = (width + word_bits - 1) / word_bits,
+                             last_bit = (width - 1) % word_bits;
+
+                const Word *rows[3] = { above, row, below };
+                Word west[3], east[3];
+
+                for (size_t r = 0; r < 3; r++) {
+                    Word west_bit = i > 0 ? rows[r][i - 1] >> (word_bits - 1)
+                                          : wrap ? (rows[r][words - 1] >> last_bit) & 1 : 0;
+                    Word east_bit = i + 1 < words ? rows[r][i + 1] << (word_bits - 1)
+                                                  : wrap ? (rows[r][0] & 1) << last_bit : 0;
+
+                    west[r] = (rows[r][i] << 1) | west_bit;
+                    east[r] = (rows[r][i] >> 1) | east_bit;
+                }
+
+                Word next = ruleWord<Word>(R(rule),
+                                           west[0], above[i], east[0],
+                                           west[1], row[i], east[1],
+                                           west[2], below[i], east[2]);
+
+                // bits past the end of the row stay zero
+                if (i + 1 == words && last_bit + 1 < word_bits) {
+                    next &= (Word(1) << (last_bit + 1)) - 1;
+                }
+
+                return next;
+            }
+        }
+
+        struct Functions {
+            void (*words)(const Rule &rule, const Word *above, const Word *row, const Word *below, Word *next_row, size_t begin, size_t end);
+            Word (*edge)(const Rule &rule, const Word *above, const Word *row, const Word *below, size_t i, size_t width, bool wrap);
+        };
+
+        namespace {
+            template <typename R>
+            Functions functionsFor(InstructionSet set) {
+                switch (set) {
+#ifdef RAINBOW_LIFE_X86_DISPATCH
+                    case AVX512: return { stepWordsAvx512<R>, stepEdgeWord<R> };
+                    case AVX2: return { stepWordsAvx2<R>, stepEdgeWord<R> };
+#endif
+                    default: return { stepWordsScalar<R>, stepEdgeWord<R> };
+                }
+            }
+
+            // the kernels of well_known_rules[Index] and of every rule after it
+            // (only the masks matter, Larger than Life rules get an unused one)
+            template <size_t Index>
+            struct WellKnown {
+                static void compile(Functions *functions) {
+                    const Rule &rule = well_known_rules[Index].rule;
+                    functions[Index] = functionsFor<FixedRule<rule.birth, rule.survival>>(dispatch.set);
+                    WellKnown<Index + 1>::compile(functions);
+                }
+            };
+
+            template <>
+            struct WellKnown<well_known_rule_count> {
+                static void compile(Functions *) {}
+            };
+
+            struct Kernels {
+                Functions well_known[well_known_rule_count];
+                Functions generic;
+
+                Kernels() : generic(functionsFor<GenericRule>(dispatch.set)) {
+                    WellKnown<0>::compile(well_known);
+                }
+            };
+
+            const Kernels kernels;
+        }
+
+        Compiled compile(const Rule &rule) {
+            for (size_t i = 0; i < well_known_rule_count; i++) {
+                const Rule &known = well_known_rules[i].rule;
+                if (known.range == 1 && known.birth == rule.birth && known.survival == rule.survival) {
+                    return { rule, &kernels.well_known[i], true };
+                }
+            }
+            return { rule, &kernels.generic, false };
+        }
+
+        void stepRow(const Compiled &kernel, const Word *above, const Word *row, const Word *below, Word *next_row,
+                     size_t width, bool wrap, size_t begin, size_t end) {
+            const size_t words = (width + word_bits - 1) / word_bits;
+
+            if (begin == 0) {
+                next_row[0] = kernel.functions->edge(kernel.rule, above, row, below, 0, width, wrap);
+                begin = 1;
+            }
+
+            if (end == words && begin < end) {
+                next_row[words - 1] = kernel.functions->edge(kernel.rule, above, row, below, words - 1, width, wrap);
+                end = words - 1;
+            }
+
+            if (begin < end) {
+                kernel.functions->words(kernel.rule, above, row, below, next_row, begin, end);
+            }
+        }
+
+        void randomRow(uint64_t key, size_t y, uint32_t steps, unsigned bits, Word *row, size_t words) {
+            switch (dispatch.set) {
+#ifdef RAINBOW_LIFE_X86_DISPATCH
+                case AVX512: randomWordsAvx512(key, y, steps, bits, row, words); break;
+                case AVX2: randomWordsAvx2(key, y, steps, bits, row, words); break;
+#endif
+                default: randomWords<Word>(key, y, steps, bits, row, words);
+            }
+        }
+
+        void randomHues(uint64_t key, size_t y, Hue *hues, size_t width) {
+            switch (dispatch.set) {
+#ifdef RAINBOW_LIFE_X86_DISPATCH
+                case AVX512: randomHuesAvx512(key, y, hues, width); break;
+                case AVX2: randomHuesAvx2(key, y, hues, width); break;
+#endif
+                default: randomHueLanes<Word>(key, y, hues, width);
+            }
+        }
+
+        const char* instructionSet() {
+            return dispatch.name;
+        }
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef KERNEL_H
+#define KERNEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include "hue.hpp"
+#include "rule.h"
+
+namespace RainbowLife {
+    // bit-parallel kernels for Life-like rules
+    //
+    // rows are packed liveness bits, 64 cells per word, in the layout of Grid.
+    // every cell of a word is computed at once by adding up the neighbour
+    // bits with full adder logic into a 4 bit count, and the rule is a
+    // boolean network on those bits, so there is no per-cell work at all.
+    // the interior words of a row are done with the widest instruction set
+    // available at runtime (AVX-512, AVX2 or plain 64 bit words), and so are
+    // the random numbers of the fills below.
+    namespace Kernel {
+        typedef uint64_t Word;
+
+        struct Functions;
+
+        // a rule compiled for stepRow(): the well known rules have kernels
+        // of their own, with the rule folded into the network at compile
+        // time, any other rule runs on a generic kernel reading its counts
+        // only birth and survival are compiled: dying cells of Generations
+        // rules are up to the caller, and Larger than Life rules (range above
+        // 1) can't run on these at all, see Grid
+        struct Compiled {
+            Rule rule;
+            const Functions *functions;
+            bool specialised;
+        };
+
+        Compiled compile(const Rule &rule);
+
+        // computes words [begin, end) of the next generation of a row into
+        // next_row, given the row above and below it (for dead edges, these
+        // can be a row of zeroes)
+        // width is in cells; wrap decides whether the first and last cell
+        // of the row are neighbours
+        void stepRow(const Compiled &kernel, const Word *above, const Word *row, const Word *below, Word *next_row,
+                     size_t width, bool wrap, size_t begin, size_t end);
+
+        // row y of a random fill, words [0, words) of it: every bit is set with
+        // a chance of steps / 2^bits, by taking a random word for every bit of
+        // steps from its lowest set one up, and or-ing it in (bit set) or
+        // and-ing it in (bit clear). the random word of bit b of word i is
+        // Random::cell(key, b * words + i, y), the same for every instruction set
+        void randomRow(uint64_t key, size_t y, uint32_t steps, unsigned bits, Word *row, size_t words);
+
+        // the hues of row y, four from every Random::cell(key, x / 4, y)
+        void randomHues(uint64_t key, size_t y, Hue *hues, size_t width);
+
+        // name of the instruction set used for interior words
+        const char* instructionSet();
+    }
+}
+
+#endif /* KERNEL_H */
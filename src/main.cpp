@@ -1,17 +1,114 @@
 #include <iostream>
 #include <vector>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <ctime>
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
 
 #include "log.hpp"
 #include "util.h"
 #include "board.h"
+#include "recording.h"
 #include "window.h"
 #include "timer.h"
+#include "profiler.h"
+#include "hud.h"
 
 int main(int argc, char const *argv[])
 {
-    srand(time(NULL));
+    // every random choice of a run follows from its seed, -r SEED reproduces a run
+    uint64_t seed = time(NULL);
+
+    // -T streams the board through a texture scaled by the renderer instead of
+    // drawing it into the window surface
+    RainbowLife::Window::Mode window_mode = RainbowLife::Window::SURFACE;
+
+    // font of the performance HUD (toggled with P), and an optional trace of
+    // every frame, CSV or JSON depending on the extension
+    std::string font_path = "/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf",
+                trace_path;
+
+    // F5 saves the board here, F9 loads it back
+    std::string snapshot_path = "rainbow_life.snapshot";
+
+    // -l starts from a pattern (RLE, .cells or Life 1.06) instead of a random
+    // board, patterns dropped onto the window replace the board as well
+    std::string pattern_path;
+    RainbowLife::Pattern::Options pattern_options;
+    pattern_options.centered = true;
+
+    // V toggles recording every generation (-o records from the start),
+    // -R plays a recording back instead of simulating
+    std::string recording_path = "rainbow_life.recording", replay_path;
+    bool recording = false;
+
+    // -s WIDTHxHEIGHT sets the size of the table, -c CELL fills the window
+    // with cells of CELL pixels instead (following its size)
+    size_t board_width = 192, board_height = 108, fill_cell_size = 0;
+
+    // -b sets the rule (B/S, S/B, Generations, Larger than Life or the name
+    // of a well known one, see Rule::parse()), B cycles through the well known rules
+    RainbowLife::Rule rule = RainbowLife::Rule::life();
+
+    // -d sets the share of living cells of random boards (R), G cycles the
+    // hues through random ones, smooth regions and a gradient
+    double density = 0.2;
+    RainbowLife::Grid::HueField hue_field = RainbowLife::Grid::RANDOM_HUES;
+
+    // -u starts on an unbounded plane (the board is a window onto it), U
+    // toggles it, and shift with the arrow keys moves the window
+    bool unbounded = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 < argc && strcmp(argv[i], "-r") == 0) {
+            seed = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "-T") == 0) {
+            window_mode = RainbowLife::Window::TEXTURE;
+        } else if (i + 1 < argc && strcmp(argv[i], "-F") == 0) {
+            font_path = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "-P") == 0) {
+            trace_path = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "-S") == 0) {
+            snapshot_path = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "-l") == 0) {
+            pattern_path = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "-o") == 0) {
+            recording_path = argv[++i];
+            recording = true;
+        } else if (i + 1 < argc && strcmp(argv[i], "-R") == 0) {
+            replay_path = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "-s") == 0 &&
+                   sscanf(argv[i + 1], "%zux%zu", &board_width, &board_height) == 2 &&
+                   board_width > 0 && board_height > 0) {
+            i++;
+        } else if (i + 1 < argc && strcmp(argv[i], "-b") == 0) {
+            try {
+                rule = RainbowLife::Rule::parse(argv[++i]);
+            } catch (const std::exception &exception) {
+                std::cerr << exception.what();
+                return 1;
+            }
+        } else if (i + 1 < argc && strcmp(argv[i], "-d") == 0 &&
+                   sscanf(argv[i + 1], "%lf", &density) == 1 && density >= 0.0 && density <= 1.0) {
+            i++;
+        } else if (strcmp(argv[i], "-u") == 0) {
+            unbounded = true;
+        } else if (i + 1 < argc && strcmp(argv[i], "-c") == 0 &&
+                   (fill_cell_size = strtoull(argv[i + 1], nullptr, 10)) > 0) {
+            i++;
+        } else {
+            std::cerr << "usage: " << argv[0] << " [-r SEED] [-T] [-F FONT] [-P TRACE.csv|TRACE.json] [-S SNAPSHOT] [-l PATTERN] [-o RECORDING] [-R RECORDING] [-s WIDTHxHEIGHT] [-c CELL] [-b RULE] [-d DENSITY] [-u]" << std::endl;
+            return 1;
+        }
+    }
+
+    log("seed: ", seed);
+    log("rule: ", rule.name());
 
     if (SDL_Init(SDL_INIT_VIDEO) != 0) {
         throw std::runtime_error(SDL_GetError());
@@ -25,22 +122,105 @@ int main(int argc, char const *argv[])
         SDL_Quit();
     });
 
-    RainbowLife::Window window;
-    RainbowLife::Board board(window.getSurface(), 192, 108, 1);
+    // a replay has the dimensions of its recording
+    std::unique_ptr<RainbowLife::Recording::Player> player;
+    RainbowLife::Frame replay_frame;
+
+    if (!replay_path.empty()) {
+        player.reset(new RainbowLife::Recording::Player(replay_path));
+        board_width = player->width();
+        board_height = player->height();
+        fill_cell_size = 0;
+    }
+
+    RainbowLife::Window window(window_mode);
+    std::unique_ptr<RainbowLife::Board> board;
+
+    if (window_mode == RainbowLife::Window::TEXTURE) {
+        board.reset(new RainbowLife::Board(window.getRenderer(), board_width, board_height, seed));
+    } else if (fill_cell_size > 0) {
+        board.reset(new RainbowLife::Board(window.getSurface(), RainbowLife::Board::CellSize{fill_cell_size}, 1, seed));
+    } else {
+        board.reset(new RainbowLife::Board(window.getSurface(), board_width, board_height, 1, seed));
+    }
+
+    auto showReplay = [&]() {
+        board->restore(replay_frame);
+    };
+
+    if (player) {
+        player->next(replay_frame);
+        showReplay();
+    }
 
     bool running = true;
     SDL_Event e;
-    bool simulate{true}, before_painting_state{true};
-    int latest_simulation = SDL_GetTicks(),
-        simulation_gap = 100;
+    bool simulate{true}, before_painting_state{true}, as_fast_as_possible{false};
+    int simulation_gap = 100;
     const int max_simulation_gap = 1000,
               simulation_gap_delta = 20;
+    const unsigned fast_forward_log2 = 10;
 
     Timer timer;
+    RainbowLife::Profiler profiler;
+
+    if (!trace_path.empty() && !profiler.openTrace(trace_path)) {
+        throw std::runtime_error("Unable to open trace file " + trace_path);
+    }
+
+    std::unique_ptr<RainbowLife::Hud> hud(new RainbowLife::Hud(font_path, RainbowLife::Profiler::summary_columns,
+                                                               RainbowLife::Profiler::summary_lines, 16, window.getRenderer()));
+    bool hud_dirty = false;
+    std::vector<SDL_Rect> updated_rects;
+    std::vector<std::string> hud_lines;
+
+    board->setRule(rule);
+
+    // boards start out at the default density
+    if (density != 0.2) {
+        board->randomizeBoard(density);
+    }
+
+    if (unbounded) {
+        board->toggleUnbounded();
+    }
+
+    if (!pattern_path.empty()) {
+        board->loadPattern(pattern_path, pattern_options);
+    }
+
+    if (recording) {
+        board->startRecording(recording_path);
+    }
+
+    // ticks happen on the simulation thread from here on, replays step in the loop below
+    board->setTickInterval(std::chrono::milliseconds(simulation_gap));
+    board->setRunning(simulate && !player);
+    board->startSimulation();
+
+    // frames are drawn once per display refresh at most (and only if
+    // something changed), the loop sleeps in between, waiting for input
+    typedef std::chrono::steady_clock clock;
+    const clock::duration frame_interval =
+        std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / window.refreshRate()));
+    clock::time_point next_frame = clock::now(),
+                      next_hud_update = next_frame,
+                      next_replay_step = next_frame;
+    const std::chrono::milliseconds hud_interval(250);
 
     while (running)
     {
-        while (SDL_PollEvent(&e))
+        // rounded up to whole milliseconds, so the wait never turns into a busy loop
+        clock::duration until_frame = next_frame - clock::now();
+        int wait = until_frame.count() > 0
+                 ? std::chrono::duration_cast<std::chrono::milliseconds>(until_frame + std::chrono::microseconds(999)).count()
+                 : 0;
+
+        bool has_event = SDL_WaitEventTimeout(&e, wait);
+        bool had_events = has_event;
+
+        timer.start();
+        while (has_event)
         {
             switch (e.type) {
                 case SDL_QUIT: {
@@ -54,43 +234,159 @@ int main(int argc, char const *argv[])
                         } break;
 
                         case SDLK_t: {
-                            board.tick();
+                            if (!player) {
+                                board->tick();
+                            } else if (player->next(replay_frame)) {
+                                showReplay();
+                            }
+                        } break;
+
+                        case SDLK_j: {
+                            if (!player) {
+                                board->fastForward(fast_forward_log2);
+                            } else {
+                                player->seek(replay_frame.generation + (uint64_t(1) << fast_forward_log2), replay_frame);
+                                showReplay();
+                            }
                         } break;
 
                         case SDLK_n: {
-                            board.clear();
+                            board->clear();
                         } break;
 
                         case SDLK_r: {
-                            board.randomizeBoard(5);
+                            board->randomizeBoard(density, hue_field);
                         } break;
 
                         case SDLK_g: {
-                            board.randomizeColors();
+                            hue_field = static_cast<RainbowLife::Grid::HueField>((hue_field + 1) % RainbowLife::Grid::hue_fields);
+                            board->randomizeColors(hue_field);
                         } break;
 
                         case SDLK_a: {
                             simulate = !simulate;
+                            board->setRunning(simulate && !player);
                         } break;
 
                         case SDLK_f: {
                             simulation_gap = simulation_gap - simulation_gap_delta > 0 ? simulation_gap - simulation_gap_delta : 1;
+                            as_fast_as_possible = false;
+                            board->setTickInterval(std::chrono::milliseconds(simulation_gap));
                         } break;
 
                         case SDLK_s: {
                             simulation_gap = simulation_gap + simulation_gap_delta < max_simulation_gap ? simulation_gap + simulation_gap_delta : max_simulation_gap;
+                            as_fast_as_possible = false;
+                            board->setTickInterval(std::chrono::milliseconds(simulation_gap));
+                        } break;
+
+                        case SDLK_m: {
+                            as_fast_as_possible = !as_fast_as_possible;
+                            board->setTickInterval(as_fast_as_possible ? std::chrono::milliseconds(0)
+                                                                       : std::chrono::milliseconds(simulation_gap));
                         } break;
 
                         case SDLK_c: {
-                            board.toggleCursor();
+                            board->toggleCursor();
                         } break;
 
                         case SDLK_d: {
-                            board.toggleDeadCellVisibility();
+                            board->toggleDeadCellVisibility();
                         } break;
 
                         case SDLK_w: {
-                            board.toggleWrap();
+                            board->toggleWrap();
+                        } break;
+
+                        case SDLK_u: {
+                            board->toggleUnbounded();
+                        } break;
+
+                        case SDLK_b: {
+                            // patterns bring their own rule, so the board has the current one
+                            size_t next = 0;
+                            for (size_t i = 0; i < RainbowLife::well_known_rule_count; i++) {
+                                if (RainbowLife::well_known_rules[i].rule == board->getFrame().rule) {
+                                    next = (i + 1) % RainbowLife::well_known_rule_count;
+                                }
+                            }
+
+                            rule = RainbowLife::well_known_rules[next].rule;
+                            board->setRule(rule);
+                            log("rule: ", rule.name());
+                        } break;
+
+                        case SDLK_v: {
+                            recording = !recording;
+
+                            if (recording) {
+                                board->startRecording(recording_path);
+                            } else {
+                                board->stopRecording();
+                            }
+                        } break;
+
+                        case SDLK_F5: {
+                            board->save(snapshot_path);
+                        } break;
+
+                        case SDLK_F9: {
+                            try {
+                                board->load(snapshot_path);
+                            } catch (const std::exception &exception) {
+                                log(exception.what());
+                            }
+                        } break;
+
+                        // zoom by factors of two, around the hovered cell
+                        case SDLK_PLUS:
+                        case SDLK_EQUALS: {
+                            board->zoom(1);
+                        } break;
+
+                        case SDLK_MINUS: {
+                            board->zoom(-1);
+                        } break;
+
+                        // panning by an eighth of the view, with shift the
+                        // window of an unbounded board moves by as much instead
+                        case SDLK_LEFT:
+                        case SDLK_RIGHT:
+                        case SDLK_UP:
+                        case SDLK_DOWN: {
+                            SDL_Rect view = board->getView();
+                            int step_x = std::max(1, view.w / 8),
+                                step_y = std::max(1, view.h / 8);
+
+                            if (e.key.keysym.mod & KMOD_SHIFT) {
+                                switch (e.key.keysym.sym) {
+                                    case SDLK_LEFT: board->moveWindow(-step_x, 0); break;
+                                    case SDLK_RIGHT: board->moveWindow(step_x, 0); break;
+                                    case SDLK_UP: board->moveWindow(0, -step_y); break;
+                                    default: board->moveWindow(0, step_y); break;
+                                }
+                                break;
+                            }
+
+                            switch (e.key.keysym.sym) {
+                                case SDLK_LEFT: board->pan(-step_x, 0); break;
+                                case SDLK_RIGHT: board->pan(step_x, 0); break;
+                                case SDLK_UP: board->pan(0, -step_y); break;
+                                default: board->pan(0, step_y); break;
+                            }
+                        } break;
+
+                        case SDLK_F11: {
+                            window.toggleFullscreen();
+                        } break;
+
+                        case SDLK_p: {
+                            hud->toggle();
+                            hud_dirty = true;
+
+                            if (!hud->isVisible()) {
+                                board->invalidate(hud->getArea());
+                            }
                         } break;
 
                         case SDLK_ESCAPE: {
@@ -101,52 +397,128 @@ int main(int argc, char const *argv[])
                     }
                 } break;
 
+                case SDL_DROPFILE: {
+                    board->loadPattern(e.drop.file, pattern_options);
+                    SDL_free(e.drop.file);
+                } break;
+
+                case SDL_MOUSEWHEEL: {
+                    if (e.wheel.y != 0) {
+                        board->zoom(e.wheel.y > 0 ? 1 : -1);
+                    }
+                } break;
+
+                case SDL_WINDOWEVENT: {
+                    // the surface of the window is a new one after resizing
+                    if (e.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
+                        board->resizeOutput(window.getSurface());
+                        hud_dirty = true;
+                    }
+                } break;
+
                 case SDL_MOUSEMOTION: {
-                    board.setCursorCoordinates(e.motion.x, e.motion.y);
+                    board->setCursorCoordinates(e.motion.x, e.motion.y);
                 } break;
 
                 case SDL_MOUSEBUTTONDOWN: {
                     before_painting_state = simulate;
 
                     if (e.button.button == SDL_BUTTON_LEFT) {
-                        board.setPaintingMode(RainbowLife::Board::PAINTING_ALIVE);
+                        board->setPaintingMode(RainbowLife::Board::PAINTING_ALIVE);
                     }
                     if (e.button.button == SDL_BUTTON_RIGHT) {
-                        board.setPaintingMode(RainbowLife::Board::PAINTING_DEAD);
+                        board->setPaintingMode(RainbowLife::Board::PAINTING_DEAD);
                     }
 
                     simulate = false;
+                    board->setRunning(simulate);
                 } break;
 
                 case SDL_MOUSEBUTTONUP: {
                     simulate = before_painting_state;
-                    board.setPaintingMode(RainbowLife::Board::NOT_PAINTING);
+                    board->setRunning(simulate && !player);
+                    board->setPaintingMode(RainbowLife::Board::NOT_PAINTING);
                 } break;
 
                 default: break;
             }
+
+            has_event = SDL_PollEvent(&e);
+        }
+        timer.stop();
+
+        if (had_events) {
+            profiler.record(RainbowLife::Profiler::EVENTS, timer.nanoseconds());
         }
 
-        if (simulate) {
-            if (static_cast<int>(SDL_GetTicks()) - latest_simulation > simulation_gap) {
-                // timer.start();
-                board.tick();
-                // timer.stop();
-                // log("tick took ", timer.duration(), "ms");
-                latest_simulation = SDL_GetTicks();
+        clock::time_point now = clock::now();
+        if (now < next_frame) {
+            continue;
+        }
+
+        // after a stall the next frame is a whole interval away, not a burst of late ones
+        next_frame += frame_interval;
+        if (next_frame < now) {
+            next_frame = now + frame_interval;
+        }
+
+        // replays step at the tick interval (without catching up)
+        if (player && simulate && now >= next_replay_step) {
+            if (player->next(replay_frame)) {
+                showReplay();
             }
+            next_replay_step = now + std::chrono::milliseconds(as_fast_as_possible ? 0 : simulation_gap);
         }
 
-        // timer.start();
-        board.render();
-        //SDL_FillRect(window.getSurface(), &mouse_rect, SDL_makeColor(255, 255, 255));
-        window.update();
-        // timer.stop();
-        // log("render took ", timer.duration(), "ms");
+        timer.start();
+        board->render();
+        profiler.recordFrame(board->getFrame());
+
+        // the HUD text is refreshed a few times a second
+        if (hud->isVisible() && (hud_dirty || now >= next_hud_update)) {
+            profiler.summary(hud_lines);
+            hud->update(hud_lines);
+            next_hud_update = now + hud_interval;
+            hud_dirty = true;
+        }
+
+        updated_rects = board->getDirtyRects();
+
+        // the panel is opaque, drawing it again is only needed if it changed,
+        // or if cells were drawn over it
+        bool hud_covered = hud_dirty;
+        for (const SDL_Rect &rect : board->getDirtyRects()) {
+            hud_covered = hud_covered || SDL_HasIntersection(&rect, &hud->getArea());
+        }
+
+        if (hud->isVisible() && hud_covered && board->getTexture() == nullptr) {
+            hud->draw(window.getSurface());
+            updated_rects.push_back(hud->getArea());
+        }
+        timer.stop();
+
+        if (updated_rects.empty() && !hud_dirty) {
+            continue;
+        }
+        profiler.record(RainbowLife::Profiler::RENDER, timer.nanoseconds());
+
+        timer.start();
+        if (board->getTexture() != nullptr) {
+            window.present(board->getTexture(), board->getTextureSource(), board->getTextureRect(),
+                           hud->isVisible() ? hud->getTexture() : nullptr, &hud->getArea());
+        } else {
+            window.update(updated_rects);
+        }
+        timer.stop();
+        profiler.record(RainbowLife::Profiler::PRESENT, timer.nanoseconds());
 
-        SDL_Delay(1);
+        profiler.endFrame();
+        hud_dirty = false;
     }
 
+    // stops the simulation thread, and the textures belong to the renderer of the window
+    board.reset();
+    hud.reset();
     window.~Window();
 
     SDL_Quit();
@@ -0,0 +1,272 @@
+#include <algorithm>
+#include "mipmap.h"
+#include "thread_pool.h"
+
+namespace RainbowLife {
+
+    // std::min binds them by reference
+    const unsigned Mipmap::base_level;
+    const unsigned Mipmap::tile_level;
+
+    namespace {
+        const size_t tile_cells = size_t(1) << Mipmap::tile_level;
+
+        // the first of the two with the most living cells
+        inline Mipmap::Sample busiest(Mipmap::Sample first, Mipmap::Sample second) {
+            return second.density > first.density ? second : first;
+        }
+    }
+
+    Mipmap::Mipmap() :
+        width(0),
+        height(0),
+        top_level(base_level)
+    {}
+
+    void Mipmap::resize(size_t width, size_t height) {
+        this->width = width;
+        this->height = height;
+
+        top_level = base_level;
+        while ((size_t(1) << top_level) < std::max(width, height)) {
+            top_level++;
+        }
+
+        levels.resize(top_level - base_level + 1);
+        widths.resize(levels.size());
+        heights.resize(levels.size());
+
+        for (unsigned level = base_level; level <= top_level; level++) {
+            size_t index = level - base_level;
+            widths[index] = (width + (size_t(1) << level) - 1) >> level;
+            heights[index] = (height + (size_t(1) << level) - 1) >> level;
+            levels[index].assign(widths[index] * heights[index], Sample{0, 0, 0});
+        }
+    }
+
+    void Mipmap::copyTo(Mipmap &mipmap, const uint8_t *tiles, ThreadPool &pool) const {
+        if (mipmap.width != width || mipmap.height != height) {
+            mipmap = *this;
+            return;
+        }
+
+        size_t tiles_x = (width + tile_cells - 1) / tile_cells,
+               tiles_y = (height + tile_cells - 1) / tile_cells;
+        unsigned last_tile_level = std::min(top_level, tile_level);
+
+        pool.run(tiles_y, [&](size_t tile_y) {
+            const uint8_t *row_tiles = tiles + tile_y * tiles_x;
+
+            // runs of flagged tiles along the row, [first, end)
+            for (size_t first = 0; first < tiles_x; first++) {
+                if (!row_tiles[first]) {
+                    continue;
+                }
+
+                size_t end = first + 1;
+                while (end < tiles_x && row_tiles[end]) {
+                    end++;
+                }
+
+                for (unsigned level = base_level; level <= last_tile_level; level++) {
+                    size_t index = level - base_level,
+                           tile_samples = tile_cells >> level,
+                           first_x = first * tile_samples,
+                           end_x = std::min(widths[index], end * tile_samples),
+                           end_y = std::min(heights[index], (tile_y + 1) * tile_samples);
+
+                    for (size_t y = tile_y * tile_samples; y < end_y; y++) {
+                        std::copy(levels[index].begin() + y * widths[index] + first_x,
+                                  levels[index].begin() + y * widths[index] + end_x,
+                                  mipmap.levels[index].begin() + y * widths[index] + first_x);
+                    }
+                }
+                first = end;
+            }
+        });
+
+        // a sample covers several tiles up there, and there are few of them
+        for (unsigned level = tile_level + 1; level <= top_level; level++) {
+            mipmap.levels[level - base_level] = levels[level - base_level];
+        }
+    }
+
+    unsigned Mipmap::topLevel() const {
+        return top_level;
+    }
+
+    size_t Mipmap::levelWidth(unsigned level) const {
+        return widths[level - base_level];
+    }
+
+    size_t Mipmap::levelHeight(unsigned level) const {
+        return heights[level - base_level];
+    }
+
+    const Mipmap::Sample* Mipmap::level(unsigned level) const {
+        return levels[level - base_level].data();
+    }
+
+    Mipmap::Sample Mipmap::sampleCells(const uint64_t *liveness, size_t words_per_row, const Hue *hues,
+                                       size_t width, size_t height, unsigned level, size_t x, size_t y) {
+        size_t first_x = x << level, end_x = std::min(width, (x + 1) << level),
+               first_y = y << level, end_y = std::min(height, (y + 1) << level);
+        uint64_t population = 0;
+        Sample sample = {0, 0, 0};
+
+        for (size_t row = first_y; row < end_y; row++) {
+            const uint64_t *words = liveness + row * words_per_row;
+
+            for (size_t cell = first_x; cell < end_x;) {
+                size_t shift = cell % 64,
+                       bits = std::min<size_t>(64 - shift, end_x - cell);
+                uint64_t alive = words[cell / 64] >> shift;
+                if (bits < 64) {
+                    alive &= (uint64_t(1) << bits) - 1;
+                }
+
+                if (alive && population == 0) {
+                    sample.hue = hues[row * width + cell + __builtin_ctzll(alive)];
+                }
+                population += __builtin_popcountll(alive);
+                cell += bits;
+            }
+        }
+
+        // rounded up, so a single cell still shows
+        uint64_t cells = uint64_t(1) << (2 * level);
+        sample.density = (population * 255 + cells - 1) / cells;
+
+        return sample;
+    }
+
+    void Mipmap::combineRow(unsigned level, size_t y, size_t first_x, size_t end_x) {
+        size_t index = level - base_level,
+               below_width = widths[index - 1];
+        const Sample empty = {0, 0, 0},
+                     *upper = levels[index - 1].data() + 2 * y * below_width,
+                     *lower = 2 * y + 1 < heights[index - 1] ? upper + below_width : nullptr;
+        Sample *samples = levels[index].data() + y * widths[index];
+
+        for (size_t x = first_x; x < end_x; x++) {
+            bool right = 2 * x + 1 < below_width;
+            Sample upper_left = upper[2 * x],
+                   upper_right = right ? upper[2 * x + 1] : empty,
+                   lower_left = lower ? lower[2 * x] : empty,
+                   lower_right = lower && right ? lower[2 * x + 1] : empty;
+
+            Sample sample = busiest(busiest(upper_left, upper_right), busiest(lower_left, lower_right));
+            sample.density = (upper_left.density + upper_right.density + lower_left.density + lower_right.density + 3) / 4;
+            samples[x] = sample;
+        }
+    }
+
+    void Mipmap::sampleTiles(const uint64_t *liveness, size_t words_per_row, const Hue *hues,
+                             size_t tile_y, const uint8_t *changed_tiles) {
+        size_t tiles_x = (width + tile_cells - 1) / tile_cells;
+
+        // base_level (2): every 4 rows of a word are 16 samples, counted 16 at
+        // a time (4 bit counts per row, added up in bytes). row by row, so
+        // the cells and hues are read in the order they are in memory
+        const uint64_t m1 = 0x5555555555555555, m2 = 0x3333333333333333, m4 = 0x0F0F0F0F0F0F0F0F;
+        size_t end_y = std::min(heights[0], (tile_y + 1) * tile_cells / 4);
+
+        for (size_t y = tile_y * tile_cells / 4; y < end_y; y++) {
+            Sample *samples = levels[0].data() + y * widths[0];
+
+            for (size_t tile_x = 0; tile_x < tiles_x; tile_x++) {
+                if (!changed_tiles[tile_x]) {
+                    continue;
+                }
+
+                uint64_t rows[4], even = 0, odd = 0;
+
+                for (size_t row = 0; row < 4; row++) {
+                    rows[row] = y * 4 + row < height ? liveness[(y * 4 + row) * words_per_row + tile_x] : 0;
+
+                    uint64_t counts = rows[row] - ((rows[row] >> 1) & m1);
+                    counts = (counts & m2) + ((counts >> 2) & m2);
+                    even += counts & m4;
+                    odd += (counts >> 4) & m4;
+                }
+
+                size_t first_x = tile_x * 16, end_x = std::min(widths[0], first_x + 16);
+
+                for (size_t x = first_x; x < end_x; x++) {
+                    unsigned block = x - first_x,
+                             population = ((block % 2 ? odd : even) >> (8 * (block / 2))) & 0xFF;
+                    Sample sample = {0, static_cast<uint8_t>((population * 255 + 15) / 16), 0};
+
+                    // the first living cell, as in sampleCells()
+                    for (size_t row = 0; population > 0 && row < 4; row++) {
+                        unsigned cells = (rows[row] >> (4 * block)) & 0xF;
+
+                        if (cells) {
+                            sample.hue = hues[(y * 4 + row) * width + x * 4 + __builtin_ctz(cells)];
+                            break;
+                        }
+                    }
+
+                    samples[x] = sample;
+                }
+            }
+        }
+
+        for (unsigned level = base_level + 1; level <= std::min(tile_level, top_level); level++) {
+            size_t index = level - base_level,
+                   tile_samples = tile_cells >> level,
+                   end_y = std::min(heights[index], (tile_y + 1) * tile_samples);
+
+            for (size_t y = tile_y * tile_samples; y < end_y; y++) {
+                for (size_t tile_x = 0; tile_x < tiles_x; tile_x++) {
+                    if (changed_tiles[tile_x]) {
+                        combineRow(level, y, tile_x * tile_samples, std::min(widths[index], (tile_x + 1) * tile_samples));
+                    }
+                }
+            }
+        }
+    }
+
+    void Mipmap::update(const uint64_t *liveness, size_t words_per_row, const Hue *hues,
+                        std::vector<uint8_t> &changed_tiles, ThreadPool &pool) {
+        size_t tiles_x = (width + tile_cells - 1) / tile_cells,
+               tiles_y = (height + tile_cells - 1) / tile_cells;
+
+        // tiles only write their own samples up to tile_level
+        pool.run(tiles_y, [&](size_t tile_y) {
+            sampleTiles(liveness, words_per_row, hues, tile_y, &changed_tiles[tile_y * tiles_x]);
+        });
+
+        // a sample above changed if one of the four below it did, the
+        // samples of tile_level are the tiles themselves
+        if (top_level > tile_level) {
+            changed.assign(changed_tiles.begin(), changed_tiles.end());
+
+            for (unsigned level = tile_level + 1; level <= top_level; level++) {
+                size_t index = level - base_level,
+                       below_width = widths[index - 1], below_height = heights[index - 1];
+
+                changed_above.assign(widths[index] * heights[index], 0);
+                for (size_t y = 0; y < below_height; y++) {
+                    for (size_t x = 0; x < below_width; x++) {
+                        if (changed[y * below_width + x]) {
+                            changed_above[y / 2 * widths[index] + x / 2] = 1;
+                        }
+                    }
+                }
+
+                for (size_t y = 0; y < heights[index]; y++) {
+                    for (size_t x = 0; x < widths[index]; x++) {
+                        if (changed_above[y * widths[index] + x]) {
+                            combineRow(level, y, x, x + 1);
+                        }
+                    }
+                }
+
+                changed.swap(changed_above);
+            }
+        }
+
+        std::fill(changed_tiles.begin(), changed_tiles.end(), 0);
+    }
+}
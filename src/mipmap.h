@@ -0,0 +1,85 @@
+#ifndef MIPMAP_H
+#define MIPMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "hue.hpp"
+
+namespace RainbowLife {
+    class ThreadPool;
+
+    // downsampled copies of the board, for drawing it zoomed out
+    //
+    // level k has a Sample for every block of 2^k x 2^k cells, from
+    // base_level up to a single block covering the whole board. the
+    // levels up to tile_level are sampled from the cells, tile by tile
+    // (the 64 x 64 cell tiles of Grid), the ones above from the level
+    // below, so only the samples over changed tiles are ever computed
+    // again, see update().
+    class Mipmap {
+    public:
+        // share of living cells in the block (0 only if there are none, 255
+        // if all are alive) and the hue of a living cell in the busiest part of it
+        struct Sample {
+            Hue hue;
+            uint8_t density;
+            uint8_t unused;
+        };
+
+        // below this, sampling the cells directly is cheap enough, see sampleCells()
+        static const unsigned base_level = 2;
+        static const unsigned tile_level = 6;
+
+    private:
+        size_t width, height;
+        unsigned top_level;
+
+        // levels[i] is level base_level + i
+        std::vector<std::vector<Sample>> levels;
+        std::vector<size_t> widths, heights;
+
+        // changed samples of the levels above tile_level, while updating
+        std::vector<uint8_t> changed, changed_above;
+
+        // the changed tiles of a row of them
+        void sampleTiles(const uint64_t *liveness, size_t words_per_row, const Hue *hues,
+                         size_t tile_y, const uint8_t *changed_tiles);
+        // samples [first_x, end_x) of row y of level, from the four below each
+        void combineRow(unsigned level, size_t y, size_t first_x, size_t end_x);
+
+    public:
+        Mipmap();
+
+        // drops every sample, update() then has to be told that all tiles changed
+        void resize(size_t width, size_t height);
+
+        // samples the tiles flagged in changed_tiles (one byte per tile, row
+        // by row) again, and clears their flags, a row of tiles per task of pool
+        // liveness and hues are laid out as in Grid
+        void update(const uint64_t *liveness, size_t words_per_row, const Hue *hues,
+                    std::vector<uint8_t> &changed_tiles, ThreadPool &pool);
+
+        // copies the samples over the tiles flagged in tiles (as in update())
+        // into mipmap, reusing its memory, a row of tiles per task of pool
+        // the levels above tile_level are copied whole, and everything if
+        // mipmap has other dimensions
+        void copyTo(Mipmap &mipmap, const uint8_t *tiles, ThreadPool &pool) const;
+
+        // levels from base_level to topLevel() exist, the top one is a single sample
+        unsigned topLevel() const;
+
+        // dimensions in samples, rounded up
+        size_t levelWidth(unsigned level) const;
+        size_t levelHeight(unsigned level) const;
+
+        // samples of a level, row by row
+        const Sample* level(unsigned level) const;
+
+        // one sample of any level (even below base_level) straight from the cells
+        static Sample sampleCells(const uint64_t *liveness, size_t words_per_row, const Hue *hues,
+                                  size_t width, size_t height, unsigned level, size_t x, size_t y);
+    };
+}
+
+#endif /* MIPMAP_H */
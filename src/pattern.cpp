@@ -0,0 +1,450 @@
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include "pattern.h"
+#include "random.hpp"
+
+namespace RainbowLife {
+    namespace Pattern {
+
+        namespace {
+            // buffered reading of a file, a chunk at a time
+            class Reader {
+                FILE *file;
+                std::string path;
+                std::vector<char> buffer;
+                size_t position, size;
+                size_t line;
+
+                bool fill() {
+                    size = fread(buffer.data(), 1, buffer.size(), file);
+                    position = 0;
+
+                    if (size == 0 && ferror(file)) {
+                        throw std::runtime_error(std::string("Unable to read pattern!\n") +
+                                                 "    - file: " + path + "\n" +
+                                                 "    - error: " + strerror(errno) + "\n");
+                    }
+
+                    return size > 0;
+                }
+
+            public:
+                Reader(const std::string &path) :
+                    file(fopen(path.c_str(), "rb")),
+                    path(path),
+                    buffer(size_t(1) << 16),
+                    position(0),
+                    size(0),
+                    line(1)
+                {
+                    if (file == nullptr) {
+                        throw std::runtime_error(std::string("Unable to open pattern!\n") +
+                                                 "    - file: " + path + "\n" +
+                                                 "    - error: " + strerror(errno) + "\n");
+                    }
+                }
+
+                ~Reader() {
+                    fclose(file);
+                }
+
+                Reader(const Reader&) = delete;
+                Reader& operator=(const Reader&) = delete;
+
+                int peek() {
+                    if (position == size && !fill()) {
+                        return EOF;
+                    }
+                    return static_cast<unsigned char>(buffer[position]);
+                }
+
+                int get() {
+                    int c = peek();
+                    if (c != EOF) {
+                        position++;
+                        line += c == '\n';
+                    }
+                    return c;
+                }
+
+                void skipLine() {
+                    int c;
+                    while ((c = get()) != EOF && c != '\n') {}
+                }
+
+                void skipBlanks() {
+                    while (peek() == ' ' || peek() == '\t' || peek() == '\r') {
+                        get();
+                    }
+                }
+
+                std::runtime_error error(const std::string &what) const {
+                    return std::runtime_error("Invalid pattern, " + what + "!\n" +
+                                              "    - file: " + path + "\n" +
+                                              "    - line: " + std::to_string(line) + "\n");
+                }
+            };
+
+            bool isDigit(int c) {
+                return c >= '0' && c <= '9';
+            }
+
+            bool isSpace(int c) {
+                return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+            }
+
+            // patterns stay far away from this, it only keeps the arithmetic from overflowing
+            const uint64_t max_coordinate = uint64_t(1) << 40;
+
+            // a signed decimal number, after optional blanks
+            int64_t readInteger(Reader &reader) {
+                reader.skipBlanks();
+
+                bool negative = reader.peek() == '-';
+                if (negative || reader.peek() == '+') {
+                    reader.get();
+                }
+
+                if (!isDigit(reader.peek())) {
+                    throw reader.error("expected a number");
+                }
+
+                uint64_t value = 0;
+                while (isDigit(reader.peek())) {
+                    value = value * 10 + (reader.get() - '0');
+                    if (value > max_coordinate) {
+                        throw reader.error("coordinate out of range");
+                    }
+                }
+
+                return negative ? -static_cast<int64_t>(value) : static_cast<int64_t>(value);
+            }
+
+            // hue of an angle in degrees
+            Hue degreesToHue(double degrees) {
+                double turns = degrees / 360.0 - std::floor(degrees / 360.0);
+                return static_cast<Hue>(static_cast<uint32_t>(turns * hue_circle) % hue_circle);
+            }
+
+            // RLE: an x = WIDTH, y = HEIGHT[, rule = RULE] header after # comments,
+            // then runs of <count><tag>, b (dead), o (alive), $ (end of row), ! (end)
+            // the letters of multi-state patterns count as alive, but for
+            // Generations rules only A is, the dying states after it are dropped
+            template <typename Sink>
+            void parseRle(Reader &reader, Sink &sink) {
+                while (reader.peek() == '#' || isSpace(reader.peek())) {
+                    if (reader.get() == '#') {
+                        reader.skipLine();
+                    }
+                }
+
+                if (reader.peek() != 'x') {
+                    throw reader.error("missing RLE header");
+                }
+
+                // the header line is short, it's the only part read as a whole
+                std::string header;
+                for (int c = reader.get(); c != EOF && c != '\n'; c = reader.get()) {
+                    if (!isSpace(c)) {
+                        header += static_cast<char>(c);
+                    }
+                    if (header.size() > 1024) {
+                        throw reader.error("RLE header too long");
+                    }
+                }
+
+                bool generations = false;
+
+                for (size_t begin = 0; begin < header.size();) {
+                    size_t end = std::min(header.find(',', begin), header.size());
+                    size_t equals = header.find('=', begin);
+
+                    if (equals >= end) {
+                        throw reader.error("malformed RLE header");
+                    }
+
+                    std::string key = header.substr(begin, equals - begin);
+
+                    // Larger than Life rules (and bounded grids) have commas of
+                    // their own, a rule runs up to the next key
+                    while (key == "rule" && end < header.size()) {
+                        size_t next_end = std::min(header.find(',', end + 1), header.size());
+                        if (header.find('=', end) < next_end) {
+                            break;
+                        }
+                        end = next_end;
+                    }
+
+                    std::string value = header.substr(equals + 1, end - equals - 1);
+
+                    if (key == "rule") {
+                        // without the bounded grid suffix of Golly (B3/S23:T100,100)
+                        Rule rule;
+                        try {
+                            rule = Rule::parse(value.substr(0, value.find(':')));
+                        } catch (const std::exception &) {
+                            throw reader.error("unsupported rule " + value);
+                        }
+                        sink.setRule(rule);
+                        generations = rule.states > 2;
+                    }
+                    if (key == "hue") {
+                        sink.setHue(degreesToHue(strtod(value.c_str(), nullptr)));
+                    }
+
+                    begin = end + 1;
+                }
+
+                int64_t x = 0, y = 0;
+                uint64_t count = 0;
+                bool prefixed = false;
+
+                for (int c = reader.get(); c != EOF && c != '!'; c = reader.get()) {
+                    if (isDigit(c)) {
+                        count = count * 10 + (c - '0');
+                        if (count > max_coordinate) {
+                            throw reader.error("run out of range");
+                        }
+                        continue;
+                    }
+
+                    uint64_t length = count ? count : 1;
+
+                    if (c == 'b' || c == '.') {
+                        x += length;
+                    } else if (c == 'o' || (c >= 'A' && c <= 'X')) {
+                        if (!generations || c == 'o' || (c == 'A' && !prefixed)) {
+                            sink.run(x, y, length);
+                        }
+                        x += length;
+                        prefixed = false;
+                    } else if (c == '$') {
+                        x = 0;
+                        y += length;
+                    } else if ((c >= 'p' && c <= 'y') || isSpace(c)) {
+                        // prefix of a multi-state letter, or formatting
+                        prefixed = prefixed || !isSpace(c);
+                        continue;
+                    } else {
+                        throw reader.error(std::string("unexpected '") + static_cast<char>(c) + "' in RLE data");
+                    }
+
+                    if (x > static_cast<int64_t>(max_coordinate) || y > static_cast<int64_t>(max_coordinate)) {
+                        throw reader.error("coordinate out of range");
+                    }
+                    count = 0;
+                }
+            }
+
+            // plaintext: ! comment lines, then one line per row, . dead, O alive
+            template <typename Sink>
+            void parsePlaintext(Reader &reader, Sink &sink) {
+                int64_t x = 0, y = 0, run_begin = 0;
+                bool line_begin = true;
+
+                for (int c = reader.get(); c != EOF; c = reader.get()) {
+                    if (line_begin && c == '!') {
+                        reader.skipLine();
+                        continue;
+                    }
+                    line_begin = false;
+
+                    if (c == 'O' || c == 'o' || c == '*') {
+                        x++;
+                        continue;
+                    }
+
+                    if (x > run_begin) {
+                        sink.run(run_begin, y, x - run_begin);
+                    }
+
+                    if (c == '.') {
+                        x++;
+                    } else if (c == '\n') {
+                        x = 0;
+                        y++;
+                        line_begin = true;
+                    } else if (!isSpace(c)) {
+                        throw reader.error(std::string("unexpected '") + static_cast<char>(c) + "' in plaintext pattern");
+                    }
+                    run_begin = x;
+                }
+
+                if (x > run_begin) {
+                    sink.run(run_begin, y, x - run_begin);
+                }
+            }
+
+            // Life 1.06: #Life 1.06, then one X Y pair per living cell
+            template <typename Sink>
+            void parseLife106(Reader &reader, Sink &sink) {
+                while (true) {
+                    while (isSpace(reader.peek())) {
+                        reader.get();
+                    }
+
+                    if (reader.peek() == EOF) {
+                        break;
+                    }
+                    if (reader.peek() == '#') {
+                        reader.skipLine();
+                        continue;
+                    }
+
+                    int64_t x = readInteger(reader);
+                    int64_t y = readInteger(reader);
+                    sink.run(x, y, 1);
+
+                    reader.skipBlanks();
+                    if (reader.peek() != '\n' && reader.peek() != EOF) {
+                        throw reader.error("expected one coordinate pair per line");
+                    }
+                }
+            }
+
+            // detects the format from the first line
+            template <typename Sink>
+            void parse(const std::string &path, Sink &sink) {
+                Reader reader(path);
+
+                while (isSpace(reader.peek())) {
+                    reader.get();
+                }
+
+                int first = reader.peek();
+
+                if (first == '!' || first == '.' || first == 'O' || first == '*') {
+                    parsePlaintext(reader, sink);
+                    return;
+                }
+
+                if (first == '#') {
+                    // the first line is one of the RLE comments, or the Life 1.0x header
+                    char line[16] = {};
+                    for (size_t i = 0; i + 1 < sizeof(line) && reader.peek() != '\n' && reader.peek() != EOF; i++) {
+                        line[i] = static_cast<char>(reader.get());
+                    }
+                    reader.skipLine();
+
+                    if (strncmp(line, "#Life 1.06", 10) == 0) {
+                        parseLife106(reader, sink);
+                        return;
+                    }
+                    if (strncmp(line, "#Life", 5) == 0) {
+                        throw reader.error(std::string("unsupported format ") + (line + 1));
+                    }
+                }
+
+                parseRle(reader, sink);
+            }
+
+            // bounding box of all runs
+            struct Measure {
+                Bounds bounds;
+                int64_t right, bottom;
+
+                Measure() : bounds{0, 0, 0, 0, 0}, right(0), bottom(0) {}
+
+                void setHue(Hue) {}
+                void setRule(const Rule &) {}
+
+                void run(int64_t x, int64_t y, uint64_t length) {
+                    if (bounds.cells == 0) {
+                        bounds.x = right = x;
+                        bounds.y = bottom = y;
+                    }
+
+                    bounds.x = std::min(bounds.x, x);
+                    bounds.y = std::min(bounds.y, y);
+                    right = std::max(right, x + static_cast<int64_t>(length));
+                    bottom = std::max(bottom, y + 1);
+                    bounds.width = right - bounds.x;
+                    bounds.height = bottom - bounds.y;
+                    bounds.cells += length;
+                }
+            };
+
+            // places the runs on the grid, clipped to the board
+            struct Writer {
+                Grid &grid;
+                int64_t offset_x, offset_y;
+                bool has_hue, fixed_hue;
+                Hue hue;
+                uint64_t key;
+                Measure measure;
+
+                Writer(Grid &grid, const Options &options) :
+                    grid(grid),
+                    offset_x(options.x),
+                    offset_y(options.y),
+                    has_hue(options.has_hue),
+                    fixed_hue(options.has_hue),
+                    hue(options.hue),
+                    key(Random::key(grid.seed(), Random::PATTERN, 0))
+                {}
+
+                // the hue in the file counts unless one was given
+                void setHue(Hue file_hue) {
+                    if (!fixed_hue) {
+                        has_hue = true;
+                        hue = file_hue;
+                    }
+                }
+
+                void setRule(const Rule &rule) {
+                    grid.setRule(rule);
+                }
+
+                void run(int64_t x, int64_t y, uint64_t length) {
+                    measure.run(x, y, length);
+
+                    x += offset_x;
+                    y += offset_y;
+                    int64_t end = std::min(x + static_cast<int64_t>(length), static_cast<int64_t>(grid.width()));
+                    x = std::max<int64_t>(x, 0);
+
+                    if (y < 0 || y >= static_cast<int64_t>(grid.height()) || x >= end) {
+                        return;
+                    }
+
+                    grid.setAliveRun(x, y, end - x);
+
+                    for (int64_t cell = x; cell < end; cell++) {
+                        grid.setHue(cell, y, has_hue ? hue : static_cast<Hue>(Random::cell(key, cell, y)));
+                    }
+                }
+            };
+        }
+
+        Bounds load(const std::string &path, Grid &grid, const Options &options) {
+            Options placement = options;
+
+            if (options.centered) {
+                Bounds bounds = measure(path);
+                placement.x = static_cast<int64_t>(grid.width() / 2) - bounds.x - static_cast<int64_t>(bounds.width / 2);
+                placement.y = static_cast<int64_t>(grid.height() / 2) - bounds.y - static_cast<int64_t>(bounds.height / 2);
+            }
+
+            if (options.clear) {
+                grid.clear();
+            }
+
+            Writer writer(grid, placement);
+            parse(path, writer);
+
+            return writer.measure.bounds;
+        }
+
+        Bounds measure(const std::string &path) {
+            Measure measure;
+            parse(path, measure);
+
+            return measure.bounds;
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "grid.h"
+#include "hue.hpp"
+
+namespace RainbowLife {
+    // Life patterns in the usual formats: RLE (as written by Golly and
+    // LifeWiki), plaintext .cells, and Life 1.06
+    //
+    // the format is detected from the first line. files are parsed as a
+    // stream, a chunk at a time, and living cells go into the grid as runs
+    // as soon as they are read, so even huge patterns need no more memory
+    // than the board itself.
+    //
+    // the rule of an RLE header (any rule Rule::parse() takes, a bounded grid
+    // suffix aside) becomes the rule of the grid. RLE headers may carry an extra
+    // hue = DEGREES attribute, which colors the whole pattern (Golly ignores
+    // attributes it doesn't know).
+    namespace Pattern {
+        struct Options {
+            // position of the origin of the pattern on the board: the top left
+            // corner for RLE and .cells, (0, 0) for Life 1.06
+            int64_t x = 0, y = 0;
+
+            // ignores x and y, and centers the bounding box of the pattern on
+            // the board (which reads the file twice)
+            bool centered = false;
+
+            // clears the board first, otherwise the pattern is added to it
+            bool clear = true;
+
+            // hue of every cell, overriding the one in the file. without
+            // either, cells get random hues (following the seed of the grid)
+            bool has_hue = false;
+            Hue hue = 0;
+        };
+
+        // bounding box of the living cells of a pattern, in its own coordinates
+        struct Bounds {
+            int64_t x, y;
+            uint64_t width, height;
+            uint64_t cells;
+        };
+
+        // reads the pattern at path into grid, cells outside the board are
+        // dropped. throws std::runtime_error if the file can't be read or parsed
+        Bounds load(const std::string &path, Grid &grid, const Options &options);
+
+        // reads the pattern at path without placing it anywhere
+        Bounds measure(const std::string &path);
+    }
+}
+
+#endif /* PATTERN_H */
@@ -0,0 +1,63 @@
+#ifndef POOL_HPP
+#define POOL_HPP
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace RainbowLife {
+    // recycled objects of a single type, allocated a slab at a time
+    //
+    // acquire() takes an object off the free list, allocating another slab
+    // of slab_size objects only when it's empty, release() puts it back.
+    // once a pool has grown to its peak, nothing is allocated anymore.
+    // objects are neither constructed nor destroyed, T has to be trivial.
+    template <typename T, size_t slab_size = 64>
+    class Pool {
+    private:
+        static_assert(std::is_trivial<T>::value, "pooled objects have to be trivial");
+
+        std::vector<std::unique_ptr<T[]>> slabs;
+        std::vector<T*> free_objects;
+
+    public:
+        Pool() = default;
+
+        Pool(const Pool&) = delete;
+        Pool& operator=(const Pool&) = delete;
+
+        // uninitialised
+        T* acquire() {
+            if (free_objects.empty()) {
+                slabs.emplace_back(new T[slab_size]);
+                free_objects.reserve(slabs.size() * slab_size);
+
+                // handed out in address order
+                for (size_t i = slab_size; i > 0; i--) {
+                    free_objects.push_back(&slabs.back()[i - 1]);
+                }
+            }
+
+            T *object = free_objects.back();
+            free_objects.pop_back();
+            return object;
+        }
+
+        void release(T *object) {
+            free_objects.push_back(object);
+        }
+
+        // objects handed out and not released
+        size_t size() const {
+            return capacity() - free_objects.size();
+        }
+
+        // objects allocated so far
+        size_t capacity() const {
+            return slabs.size() * slab_size;
+        }
+    };
+}
+
+#endif /* POOL_HPP */
@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <cstdio>
+#include "profiler.h"
+
+namespace RainbowLife {
+
+    namespace {
+        const char *phase_names[Profiler::PHASE_COUNT] = { "events", "tick", "render", "present" };
+    }
+
+    const size_t Profiler::window;
+    const size_t Profiler::summary_columns;
+    const size_t Profiler::summary_lines;
+
+    Profiler::Profiler() :
+        generation(0),
+        population(0),
+        births(0),
+        deaths(0),
+        started(std::chrono::steady_clock::now()),
+        frames(0),
+        json(false)
+    {
+        for (Samples &phase : samples) {
+            phase.ring.assign(window, 0);
+            phase.count = 0;
+            phase.latest = 0;
+        }
+
+        sorted.reserve(window);
+    }
+
+    Profiler::~Profiler() {
+        if (trace.is_open() && json) {
+            trace << "\n]\n";
+        }
+    }
+
+    bool Profiler::openTrace(const std::string &path) {
+        trace.open(path);
+
+        if (!trace.is_open()) {
+            return false;
+        }
+
+        json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+
+        if (json) {
+            trace << "[";
+        } else {
+            trace << "frame,milliseconds";
+            for (const char *name : phase_names) {
+                trace << "," << name << "_ns";
+            }
+            trace << ",generation,population,births,deaths\n";
+        }
+
+        return true;
+    }
+
+    void Profiler::record(Phase phase, uint64_t nanoseconds) {
+        Samples &phase_samples = samples[phase];
+
+        phase_samples.ring[phase_samples.count % window] = nanoseconds;
+        phase_samples.count++;
+        phase_samples.latest = nanoseconds;
+    }
+
+    void Profiler::recordFrame(const Frame &frame) {
+        if (frame.generation != generation && frame.tick_nanoseconds > 0) {
+            record(TICK, frame.tick_nanoseconds);
+        }
+
+        generation = frame.generation;
+        population = frame.population;
+        births = frame.births;
+        deaths = frame.deaths;
+    }
+
+    void Profiler::endFrame() {
+        if (trace.is_open()) {
+            double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+
+            if (json) {
+                trace << (frames > 0 ? ",\n" : "\n") << "  {\"frame\": " << frames << ", \"milliseconds\": " << milliseconds;
+                for (size_t phase = 0; phase < PHASE_COUNT; phase++) {
+                    trace << ", \"" << phase_names[phase] << "_ns\": " << samples[phase].latest;
+                }
+                trace << ", \"generation\": " << generation << ", \"population\": " << population
+                      << ", \"births\": " << births << ", \"deaths\": " << deaths << "}";
+            } else {
+                trace << frames << "," << milliseconds;
+                for (const Samples &phase : samples) {
+                    trace << "," << phase.latest;
+                }
+                trace << "," << generation << "," << population << "," << births << "," << deaths << "\n";
+            }
+        }
+
+        for (Samples &phase : samples) {
+            phase.latest = 0;
+        }
+        frames++;
+    }
+
+    uint64_t Profiler::percentile(Phase phase, double fraction) const {
+        const Samples &phase_samples = samples[phase];
+        size_t count = std::min(phase_samples.count, window);
+
+        if (count == 0) {
+            return 0;
+        }
+
+        sorted.assign(phase_samples.ring.begin(), phase_samples.ring.begin() + count);
+
+        size_t rank = std::min(count - 1, static_cast<size_t>(fraction * count));
+        std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+        return sorted[rank];
+    }
+
+    void Profiler::summary(std::vector<std::string> &lines) const {
+        char line[summary_columns + 1];
+
+        if (lines.size() != summary_lines) {
+            lines.assign(summary_lines, std::string());
+            for (std::string &text : lines) {
+                text.reserve(summary_columns);
+            }
+        }
+
+        for (size_t phase = 0; phase < PHASE_COUNT; phase++) {
+            snprintf(line, sizeof(line), "%-8s p50 %8.3f ms  p99 %8.3f ms", phase_names[phase],
+                     percentile(static_cast<Phase>(phase), 0.50) / 1e6,
+                     percentile(static_cast<Phase>(phase), 0.99) / 1e6);
+            lines[phase].assign(line);
+        }
+
+        snprintf(line, sizeof(line), "generation %llu  live %llu  +%llu -%llu",
+                 static_cast<unsigned long long>(generation), static_cast<unsigned long long>(population),
+                 static_cast<unsigned long long>(births), static_cast<unsigned long long>(deaths));
+        lines[PHASE_COUNT].assign(line);
+    }
+};
@@ -0,0 +1,78 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "frame.hpp"
+
+namespace RainbowLife {
+    // per phase timings of the main loop, and cell counters of the simulation
+    //
+    // every phase keeps its last samples in a ring, percentiles are computed
+    // over those. tick timings come from the frames (the simulation has its
+    // own thread), one sample for every new generation shown.
+    // optionally every frame is written to a trace file, CSV or JSON
+    // (chosen by the extension of its name).
+    class Profiler {
+    public:
+        enum Phase {
+            EVENTS,
+            TICK,
+            RENDER,
+            PRESENT,
+            PHASE_COUNT
+        };
+
+        // summary() has summary_lines lines of at most summary_columns characters
+        static const size_t summary_columns = 127, summary_lines = PHASE_COUNT + 1;
+
+    private:
+        static const size_t window = 512;
+
+        struct Samples {
+            std::vector<uint64_t> ring;
+            size_t count;
+
+            // sample of the current frame, 0 if there was none (for the trace)
+            uint64_t latest;
+        };
+
+        Samples samples[PHASE_COUNT];
+        mutable std::vector<uint64_t> sorted;
+
+        uint64_t generation, population, births, deaths;
+
+        std::chrono::steady_clock::time_point started;
+        uint64_t frames;
+
+        std::ofstream trace;
+        bool json;
+
+    public:
+        Profiler();
+        ~Profiler();
+
+        // starts writing every frame to path, returns false if it can't be opened
+        bool openTrace(const std::string &path);
+
+        void record(Phase phase, uint64_t nanoseconds);
+
+        // takes the counters (and the tick timing, if it's a new generation) of a frame
+        void recordFrame(const Frame &frame);
+
+        // writes the trace line of the frame, and starts the next one
+        void endFrame();
+
+        // in nanoseconds, over the last samples of the phase (0 without samples)
+        uint64_t percentile(Phase phase, double fraction) const;
+
+        // a few lines of text for the HUD, into lines (reusing their memory,
+        // sized for the longest lines by the first call)
+        void summary(std::vector<std::string> &lines) const;
+    };
+}
+
+#endif /* PROFILER_H */
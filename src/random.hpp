@@ -0,0 +1,46 @@
+#ifndef RANDOM_HPP
+#define RANDOM_HPP
+
+#include <cstdint>
+
+namespace RainbowLife {
+    // counter based random numbers
+    //
+    // there is no generator state: every number is a hash of its key
+    // (seed, stream, generation, cell coordinates), so a tick gives the same
+    // result no matter which thread computes which cell, or in what order.
+    namespace Random {
+        // independent streams of numbers for the different uses
+        enum Stream : uint64_t {
+            MUTATION = 1,
+            LIVENESS = 2,
+            HUE = 3,
+            PATTERN = 4
+        };
+
+        // splitmix64 finalizer
+        inline uint64_t mix(uint64_t value) {
+            value += 0x9E3779B97F4A7C15ull;
+            value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+            value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+            return value ^ (value >> 31);
+        }
+
+        // key of a whole generation of a stream, computed once per tick
+        inline uint64_t key(uint64_t seed, Stream stream, uint64_t generation) {
+            return mix(mix(seed ^ mix(stream)) ^ generation);
+        }
+
+        // number of a single cell within a key
+        inline uint64_t cell(uint64_t key, uint64_t x, uint64_t y) {
+            return mix(key ^ ((x << 32) | (y & 0xFFFFFFFFull)));
+        }
+
+        // uniformly distributed in [0, 1)
+        inline double unit(uint64_t bits) {
+            return (bits >> 11) * (1.0 / 9007199254740992.0);
+        }
+    }
+}
+
+#endif /* RANDOM_HPP */
@@ -0,0 +1,450 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include "log.hpp"
+#include "recording.h"
+
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "recordings are stored little endian, and read and written without conversion"
+#endif
+
+namespace RainbowLife {
+    namespace Recording {
+
+        namespace {
+            typedef Grid::Word Word;
+
+            const char magic[8] = { 'R', 'A', 'I', 'N', 'B', 'O', 'W', 'R' };
+
+            void putVarint(std::vector<uint8_t> &out, uint64_t value) {
+                while (value >= 0x80) {
+                    out.push_back(static_cast<uint8_t>(value) | 0x80);
+                    value >>= 7;
+                }
+                out.push_back(static_cast<uint8_t>(value));
+            }
+
+            bool getVarint(const uint8_t *&in, const uint8_t *end, uint64_t &value) {
+                value = 0;
+                for (unsigned shift = 0; in < end && shift < 64; shift += 7) {
+                    uint8_t byte = *in++;
+                    value |= uint64_t(byte & 0x7F) << shift;
+                    if (!(byte & 0x80)) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            // pairs of (zero words, nonzero words) counts, every nonzero word
+            // followed by a mask of its nonzero bytes and those bytes
+            void compress(const Word *words, size_t count, std::vector<uint8_t> &out) {
+                size_t index = 0;
+
+                while (index < count) {
+                    size_t zeros = 0, literals = 0;
+                    while (index + zeros < count && words[index + zeros] == 0) {
+                        zeros++;
+                    }
+                    index += zeros;
+                    while (index + literals < count && words[index + literals] != 0) {
+                        literals++;
+                    }
+
+                    putVarint(out, zeros);
+                    putVarint(out, literals);
+
+                    for (; literals > 0; literals--, index++) {
+                        Word word = words[index];
+                        size_t mask_position = out.size();
+                        uint8_t mask = 0;
+
+                        out.push_back(0);
+                        for (unsigned byte = 0; byte < 8; byte++, word >>= 8) {
+                            if (word & 0xFF) {
+                                mask |= 1 << byte;
+                                out.push_back(static_cast<uint8_t>(word));
+                            }
+                        }
+                        out[mask_position] = mask;
+                    }
+                }
+            }
+
+            // the most bytes compress() writes for count words: 9 per nonzero word,
+            // and 2 counts per run of zero and nonzero words (of 1 byte, and 1
+            // more per 128 words), where every run but the first and last has
+            // at least one word of each
+            size_t compressBound(size_t count) {
+                return count * 10 + count / 128 + 2;
+            }
+
+            bool decompress(const uint8_t *&in, const uint8_t *end, Word *words, size_t count) {
+                size_t index = 0;
+
+                while (index < count) {
+                    uint64_t zeros, literals;
+                    if (!getVarint(in, end, zeros) || !getVarint(in, end, literals) ||
+                        zeros > count - index || literals > count - index - zeros) {
+                        return false;
+                    }
+
+                    std::fill(words + index, words + index + zeros, 0);
+                    index += zeros;
+
+                    for (; literals > 0; literals--, index++) {
+                        if (in == end) {
+                            return false;
+                        }
+
+                        uint8_t mask = *in++;
+                        Word word = 0;
+
+                        for (unsigned byte = 0; byte < 8; byte++) {
+                            if (mask & (1 << byte)) {
+                                if (in == end) {
+                                    return false;
+                                }
+                                word |= Word(*in++) << (8 * byte);
+                            }
+                        }
+                        words[index] = word;
+                    }
+                }
+
+                return true;
+            }
+
+            std::runtime_error error(const std::string &what, const std::string &path) {
+                return std::runtime_error(what + "\n" +
+                                          "    - file: " + path + "\n" +
+                                          "    - error: " + strerror(errno) + "\n");
+            }
+        }
+
+        static_assert(sizeof(Header) == 32, "the recording header is 32 bytes");
+        static_assert(sizeof(RecordHeader) == 40, "the record header is 40 bytes");
+
+        Recorder::Recorder(const std::string &path, size_t width, size_t height, uint32_t keyframe_interval) :
+            file(fopen(path.c_str(), "wb")),
+            path(path),
+            width(width),
+            height(height),
+            words_per_row((width + Grid::word_bits - 1) / Grid::word_bits),
+            keyframe_interval(keyframe_interval),
+            since_keyframe(0),
+            keyframe_requested(true),
+            previous(words_per_row * height, 0),
+            queued_first(0),
+            queued_count(0),
+            closing(false)
+        {
+            if (file == nullptr) {
+                throw error("Unable to create recording!", path);
+            }
+
+            Header header;
+            memcpy(header.magic, magic, sizeof(magic));
+            header.version = version;
+            header.keyframe_interval = keyframe_interval;
+            header.width = width;
+            header.height = height;
+
+            if (fwrite(&header, sizeof(header), 1, file) != 1) {
+                fclose(file);
+                throw error("Unable to write recording!", path);
+            }
+
+            // sized for the worst case (a keyframe of a full board) up front,
+            // so recording allocates nothing after this
+            free.reserve(chunk_count);
+            for (size_t i = 0; i < chunk_count; i++) {
+                chunks.emplace_back(new Chunk());
+                chunks.back()->words.reserve(previous.size());
+                chunks.back()->hues.reserve(width * height);
+                free.push_back(chunks.back().get());
+            }
+            payload.reserve(compressBound(previous.size()) + width * height * sizeof(Hue));
+
+            writer = std::thread(&Recorder::write, this);
+        }
+
+        Recorder::~Recorder() {
+            {
+                std::lock_guard<std::mutex> lock(chunks_mutex);
+                closing = true;
+            }
+            chunk_queued.notify_one();
+            writer.join();
+
+            fclose(file);
+        }
+
+        void Recorder::record(const Grid &grid) {
+            Chunk *chunk;
+            {
+                std::unique_lock<std::mutex> lock(chunks_mutex);
+                chunk_freed.wait(lock, [this]() { return !free.empty(); });
+                chunk = free.back();
+                free.pop_back();
+            }
+
+            bool keyframe = keyframe_requested || since_keyframe >= keyframe_interval;
+            since_keyframe = keyframe ? 1 : since_keyframe + 1;
+            keyframe_requested = false;
+
+            const Word *cells = grid.liveness();
+            chunk->words.resize(previous.size());
+            chunk->hues.clear();
+
+            // the hues of every living cell (keyframes) or of every newborn one (deltas)
+            for (size_t y = 0; y < height; y++) {
+                for (size_t word = 0; word < words_per_row; word++) {
+                    size_t index = y * words_per_row + word;
+                    Word changed = cells[index] ^ previous[index];
+                    Word hued = keyframe ? cells[index] : changed & cells[index];
+
+                    chunk->words[index] = keyframe ? cells[index] : changed;
+                    previous[index] = cells[index];
+
+                    for (; hued != 0; hued &= hued - 1) {
+                        chunk->hues.push_back(grid.hue(word * Grid::word_bits + __builtin_ctzll(hued), y));
+                    }
+                }
+            }
+
+            chunk->header.type = keyframe ? KEYFRAME : DELTA;
+            const Rule &rule = grid.getRule();
+            chunk->header.flags = (grid.isWrapping() ? WRAPPING : 0) | (rule.isLifeLike() ? RULE | rule.bits() << rule_shift : 0);
+            chunk->header.generation = grid.generation();
+            chunk->header.seed = grid.seed();
+            chunk->header.hue_count = chunk->hues.size();
+
+            {
+                std::lock_guard<std::mutex> lock(chunks_mutex);
+                queued[(queued_first + queued_count++) % chunk_count] = chunk;
+            }
+            chunk_queued.notify_one();
+        }
+
+        void Recorder::requestKeyframe() {
+            keyframe_requested = true;
+        }
+
+        const std::string& Recorder::getPath() const {
+            return path;
+        }
+
+        // writer thread: compresses and writes the queued chunks, until closed
+        void Recorder::write() {
+            bool failed = false;
+
+            while (true) {
+                Chunk *chunk;
+                {
+                    std::unique_lock<std::mutex> lock(chunks_mutex);
+                    chunk_queued.wait(lock, [this]() { return closing || queued_count > 0; });
+
+                    if (queued_count == 0) {
+                        break;
+                    }
+                    chunk = queued[queued_first];
+                    queued_first = (queued_first + 1) % chunk_count;
+                    queued_count--;
+                }
+
+                payload.clear();
+                compress(chunk->words.data(), chunk->words.size(), payload);
+
+                const uint8_t *hues = reinterpret_cast<const uint8_t*>(chunk->hues.data());
+                payload.insert(payload.end(), hues, hues + chunk->hues.size() * sizeof(Hue));
+                chunk->header.size = payload.size();
+
+                // a failed write leaves a truncated recording, which still plays up to there
+                if (!failed && (fwrite(&chunk->header, sizeof(chunk->header), 1, file) != 1 ||
+                                fwrite(payload.data(), 1, payload.size(), file) != payload.size())) {
+                    log(error("Unable to write recording!", path).what());
+                    failed = true;
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock(chunks_mutex);
+                    free.push_back(chunk);
+                }
+                chunk_freed.notify_one();
+            }
+        }
+
+        Player::Player(const std::string &path) :
+            file(fopen(path.c_str(), "rb")),
+            path(path),
+            position(0)
+        {
+            if (file == nullptr) {
+                throw error("Unable to open recording!", path);
+            }
+
+            if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, magic, sizeof(magic)) != 0) {
+                fclose(file);
+                throw std::runtime_error("Invalid recording, not a Rainbow Life recording!\n    - file: " + path + "\n");
+            }
+
+            if (header.version != version) {
+                fclose(file);
+                throw std::runtime_error(std::string("Unsupported recording version!\n") +
+                                         "    - file: " + path + "\n" +
+                                         "    - version: " + std::to_string(header.version) + "\n" +
+                                         "    - supported version: " + std::to_string(version) + "\n");
+            }
+
+            if (!Frame::validDimensions(header.width, header.height)) {
+                fclose(file);
+                throw std::runtime_error(std::string("Invalid recording, unsupported dimensions!\n") +
+                                         "    - file: " + path + "\n" +
+                                         "    - dimensions: " + std::to_string(header.width) + "x" + std::to_string(header.height) + "\n");
+            }
+
+            fseeko(file, 0, SEEK_END);
+            uint64_t size = ftello(file);
+            uint64_t offset = sizeof(header);
+            RecordHeader record;
+
+            // payloads are read into the same buffer, sized for the biggest up front
+            uint64_t largest = 0;
+
+            while (fseeko(file, offset, SEEK_SET) == 0 && fread(&record, sizeof(record), 1, file) == 1 &&
+                   record.size <= size - offset - sizeof(record)) {
+                index.push_back({ record.generation, offset, record.type == KEYFRAME });
+                offset += sizeof(record) + record.size;
+                largest = std::max(largest, record.size);
+            }
+
+            if (index.empty() || !index.front().keyframe) {
+                fclose(file);
+                throw std::runtime_error("Invalid recording, no records!\n    - file: " + path + "\n");
+            }
+
+            words.resize((header.width + Grid::word_bits - 1) / Grid::word_bits * header.height);
+            payload.reserve(largest);
+        }
+
+        Player::~Player() {
+            fclose(file);
+        }
+
+        size_t Player::width() const {
+            return header.width;
+        }
+
+        size_t Player::height() const {
+            return header.height;
+        }
+
+        size_t Player::recordCount() const {
+            return index.size();
+        }
+
+        void Player::decode(size_t record, Frame &frame) {
+            RecordHeader record_header;
+
+            if (fseeko(file, index[record].offset, SEEK_SET) != 0 ||
+                fread(&record_header, sizeof(record_header), 1, file) != 1) {
+                throw error("Unable to read recording!", path);
+            }
+
+            payload.resize(record_header.size);
+            if (fread(payload.data(), 1, payload.size(), file) != payload.size()) {
+                throw error("Unable to read recording!", path);
+            }
+
+            const uint8_t *in = payload.data(), *end = in + payload.size();
+            if (!decompress(in, end, words.data(), words.size()) ||
+                static_cast<uint64_t>(end - in) % sizeof(Hue) != 0 ||
+                static_cast<uint64_t>(end - in) / sizeof(Hue) != record_header.hue_count) {
+                throw std::runtime_error(std::string("Invalid recording, corrupt record!\n") +
+                                         "    - file: " + path + "\n" +
+                                         "    - generation: " + std::to_string(record_header.generation) + "\n");
+            }
+
+            bool keyframe = record_header.type == KEYFRAME;
+
+            frame.width = header.width;
+            frame.height = header.height;
+            frame.words_per_row = (header.width + Grid::word_bits - 1) / Grid::word_bits;
+            frame.generation = record_header.generation;
+            frame.wrap = record_header.flags & WRAPPING;
+            frame.rule = record_header.flags & RULE ? Rule::fromBits(record_header.flags >> rule_shift) : Rule::life();
+            frame.seed = record_header.seed;
+            frame.randomizations = 0;
+            frame.tick_nanoseconds = 0;
+            frame.cells.resize(words.size());
+            frame.hues.resize(header.width * header.height);
+            frame.decay.clear();
+            frame.population = frame.births = frame.deaths = 0;
+
+            // the bits after the end of a row have to stay zero
+            if (header.width % Grid::word_bits != 0) {
+                Word row_mask = (Word(1) << (header.width % Grid::word_bits)) - 1;
+
+                for (size_t y = 0; y < header.height; y++) {
+                    words[(y + 1) * frame.words_per_row - 1] &= row_mask;
+                }
+            }
+
+            size_t hue = 0;
+            for (size_t y = 0; y < header.height; y++) {
+                for (size_t word = 0; word < frame.words_per_row; word++) {
+                    size_t cell = y * frame.words_per_row + word;
+                    Word hued;
+
+                    if (keyframe) {
+                        frame.cells[cell] = hued = words[cell];
+                    } else {
+                        frame.cells[cell] ^= words[cell];
+                        hued = words[cell] & frame.cells[cell];
+                        frame.births += __builtin_popcountll(hued);
+                        frame.deaths += __builtin_popcountll(words[cell] & ~frame.cells[cell]);
+                    }
+                    frame.population += __builtin_popcountll(frame.cells[cell]);
+
+                    for (; hued != 0; hued &= hued - 1, hue++) {
+                        if (hue == record_header.hue_count) {
+                            throw std::runtime_error("Invalid recording, missing hues!\n    - file: " + path + "\n");
+                        }
+
+                        Hue value;
+                        memcpy(&value, in + hue * sizeof(Hue), sizeof(Hue));
+                        frame.hues[y * header.width + word * Grid::word_bits + __builtin_ctzll(hued)] = value;
+                    }
+                }
+            }
+        }
+
+        bool Player::next(Frame &frame) {
+            if (position == index.size()) {
+                return false;
+            }
+
+            decode(position++, frame);
+            return true;
+        }
+
+        void Player::seek(uint64_t generation, Frame &frame) {
+            // the last record at or before generation
+            size_t target = 0;
+            while (target + 1 < index.size() && index[target + 1].generation <= generation) {
+                target++;
+            }
+
+            size_t keyframe = target;
+            while (!index[keyframe].keyframe) {
+                keyframe--;
+            }
+
+            for (position = keyframe; position <= target; position++) {
+                decode(position, frame);
+            }
+        }
+    }
+}
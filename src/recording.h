@@ -0,0 +1,170 @@
+#ifndef RECORDING_H
+#define RECORDING_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "frame.hpp"
+#include "grid.h"
+
+namespace RainbowLife {
+    // recordings of whole runs, one record per recorded generation
+    //
+    // layout (little endian): a Header, then records, each a RecordHeader
+    // followed by its payload: the liveness words of the board, compressed,
+    // then the 16 bit hues of some cells, in row order.
+    //  - a keyframe has the liveness of the board, and the hues of the living cells
+    //  - a delta has the XOR of its liveness and the previous record's, and the
+    //    hues of the cells born in between (other living cells keep theirs)
+    // the compression is a light one for mostly zero words: runs of zero words
+    // are skipped, the others are stored as a mask of their nonzero bytes and
+    // those bytes.
+    namespace Recording {
+        const uint32_t version = 1;
+
+        struct Header {
+            char magic[8];
+            uint32_t version;
+            uint32_t keyframe_interval;
+            uint64_t width, height;
+        };
+
+        enum RecordType : uint32_t {
+            KEYFRAME = 1,
+            DELTA = 2
+        };
+
+        // with RULE, the bits from rule_shift on are Rule::bits(), without it the rule is Life
+        // rules that aren't Life-like are recorded without RULE (and without
+        // dying cells), so replays of those show the living cells only
+        enum Flags : uint32_t {
+            WRAPPING = 1,
+            RULE = 2
+        };
+
+        const unsigned rule_shift = 8;
+
+        struct RecordHeader {
+            uint32_t type;
+            uint32_t flags;
+            uint64_t generation;
+            uint64_t seed;
+            uint64_t size;
+            uint64_t hue_count;
+        };
+
+        // writes a recording, record() is called after every tick (and after edits)
+        //
+        // record() only extracts the delta, compressing and writing it happens
+        // on a thread of its own. if that falls behind by more than a few
+        // records, record() waits for it, so a recording never has gaps.
+        class Recorder {
+        public:
+            static const uint32_t default_keyframe_interval = 256;
+
+        private:
+            struct Chunk {
+                RecordHeader header;
+                std::vector<Grid::Word> words;
+                std::vector<Hue> hues;
+            };
+
+            static const size_t chunk_count = 4;
+
+            FILE *file;
+            std::string path;
+            size_t width, height, words_per_row;
+            uint32_t keyframe_interval;
+            size_t since_keyframe;
+            bool keyframe_requested;
+
+            // liveness of the last record
+            std::vector<Grid::Word> previous;
+
+            // the record the writer thread compresses, only it uses it
+            std::vector<uint8_t> payload;
+
+            // chunks go from record() to the writer thread through queued, and back through free
+            // queued is a ring of queued_count chunks from queued_first on (there
+            // are no more than chunk_count), so passing them around allocates nothing
+            std::vector<std::unique_ptr<Chunk>> chunks;
+            std::vector<Chunk*> free;
+            Chunk *queued[chunk_count];
+            size_t queued_first, queued_count;
+            std::mutex chunks_mutex;
+            std::condition_variable chunk_queued, chunk_freed;
+            bool closing;
+            std::thread writer;
+
+            void write();
+
+        public:
+            // throws std::runtime_error if path can't be created
+            Recorder(const std::string &path, size_t width, size_t height,
+                     uint32_t keyframe_interval = default_keyframe_interval);
+            ~Recorder();
+
+            Recorder(const Recorder&) = delete;
+            Recorder& operator=(const Recorder&) = delete;
+
+            void record(const Grid &grid);
+
+            // makes the next record a keyframe, after the hues of living cells changed
+            void requestKeyframe();
+
+            const std::string& getPath() const;
+        };
+
+        // reads a recording back, seeking through the keyframes
+        //
+        // opening scans the record headers (not the payloads) for an index, a
+        // recording cut short (by a crash) ends with its last complete record.
+        // the hues of dead cells (only shown with dead cell visibility) are
+        // those of the record decoded before, zero after a seek.
+        class Player {
+            struct Entry {
+                uint64_t generation, offset;
+                bool keyframe;
+            };
+
+            FILE *file;
+            std::string path;
+            Header header;
+            std::vector<Entry> index;
+            size_t position;
+
+            std::vector<uint8_t> payload;
+            std::vector<Grid::Word> words;
+
+            void decode(size_t record, Frame &frame);
+
+        public:
+            // throws std::runtime_error if path can't be read, isn't a recording,
+            // or has dimensions outside Frame::validDimensions()
+            Player(const std::string &path);
+            ~Player();
+
+            Player(const Player&) = delete;
+            Player& operator=(const Player&) = delete;
+
+            size_t width() const;
+            size_t height() const;
+            size_t recordCount() const;
+
+            // decodes the next record into frame, which has to hold the one
+            // before (nothing for the first), false after the last
+            bool next(Frame &frame);
+
+            // decodes the last record at or before generation (or the first
+            // record) into frame, starting from the keyframe before it
+            void seek(uint64_t generation, Frame &frame);
+        };
+    }
+}
+
+#endif /* RECORDING_H */
@@ -0,0 +1,266 @@
+#include <cctype>
+#include <stdexcept>
+#include "rule.h"
+
+namespace RainbowLife {
+
+    const uint16_t Rule::max_range;
+
+    namespace {
+        // letters and digits only, lowercase, so names match loosely
+        std::string normalised(const std::string &text) {
+            std::string result;
+            for (char c : text) {
+                if (isalnum(static_cast<unsigned char>(c))) {
+                    result += static_cast<char>(tolower(static_cast<unsigned char>(c)));
+                }
+            }
+            return result;
+        }
+
+        std::runtime_error unsupported(const std::string &what, const std::string &text) {
+            return std::runtime_error(what + "\n" +
+                                      "    - rule: " + text + "\n");
+        }
+
+        // neighbour counts from position on, up to the first character that isn't one
+        uint16_t counts(const std::string &text, size_t &position) {
+            uint16_t mask = 0;
+            for (; position < text.size() && text[position] >= '0' && text[position] <= '8'; position++) {
+                mask |= 1 << (text[position] - '0');
+            }
+            return mask;
+        }
+
+        // a decimal number from position on, throws if there is none, or it doesn't fit 16 bits
+        uint16_t number(const std::string &text, size_t &position, const std::string &rule) {
+            size_t begin = position;
+            unsigned value = 0;
+
+            for (; position < text.size() && isdigit(static_cast<unsigned char>(text[position])); position++) {
+                value = value * 10 + (text[position] - '0');
+                if (value > UINT16_MAX) {
+                    throw unsupported("Unable to parse rule!", rule);
+                }
+            }
+
+            if (position == begin) {
+                throw unsupported("Unable to parse rule!", rule);
+            }
+            return static_cast<uint16_t>(value);
+        }
+
+        // the counts in [min, max] as a mask, for range 1
+        uint16_t intervalMask(unsigned min, unsigned max) {
+            uint16_t mask = 0;
+            for (unsigned n = min; n <= max && n <= 8; n++) {
+                mask |= 1 << n;
+            }
+            return mask;
+        }
+
+        // R5,C0,M1,S34..58,B34..45,NM, in any order
+        Rule parseLargerThanLife(const std::string &notation, const std::string &text) {
+            unsigned range = 0, states = 2, middle = 0;
+            unsigned birth[2] = { 1, 0 }, survival[2] = { 1, 0 };
+            bool seen_birth = false, seen_survival = false;
+
+            for (size_t begin = 0; begin <= notation.size();) {
+                size_t end = notation.find(',', begin);
+                end = end == std::string::npos ? notation.size() : end;
+
+                std::string part = notation.substr(begin, end - begin);
+                size_t position = 1;
+
+                switch (part.empty() ? '\0' : part[0]) {
+                    case 'R': range = number(part, position, text); break;
+                    case 'C': states = number(part, position, text); break;
+                    case 'M': middle = number(part, position, text); break;
+                    case 'N': position = part == "NM" ? part.size() : 0; break;
+
+                    case 'B':
+                    case 'S': {
+                        unsigned *interval = part[0] == 'B' ? birth : survival;
+                        (part[0] == 'B' ? seen_birth : seen_survival) = true;
+
+                        interval[0] = interval[1] = number(part, position, text);
+                        if (part.compare(position, 2, "..") == 0) {
+                            position += 2;
+                            interval[1] = number(part, position, text);
+                        }
+                    } break;
+
+                    default: position = 0;
+                }
+
+                if (position != part.size() || position == 0) {
+                    throw unsupported("Unable to parse rule, only R, C, M, S, B and NM are supported!", text);
+                }
+                begin = end + 1;
+            }
+
+            if (!seen_birth || !seen_survival || middle > 1) {
+                throw unsupported("Unable to parse rule!", text);
+            }
+
+            // with M1 a living cell counts itself, so it survives with one neighbour less
+            if (middle) {
+                if (survival[1] == 0) {
+                    survival[0] = 1;
+                } else {
+                    survival[0] -= survival[0] > 0;
+                    survival[1]--;
+                }
+            }
+
+            // C0 and C1 are both two states
+            states = states < 2 ? 2 : states;
+
+            unsigned most = (2 * range + 1) * (2 * range + 1);
+            if (range == 0 || range > Rule::max_range || states > 256 ||
+                birth[0] > most || birth[1] > most || survival[0] > most || survival[1] > most) {
+                throw unsupported("Unsupported rule, range, states or counts out of bounds!", text);
+            }
+
+            if (range == 1) {
+                return Rule(intervalMask(birth[0], birth[1]), intervalMask(survival[0], survival[1]), states);
+            }
+            return Rule(range, states, birth[0], birth[1], survival[0], survival[1]);
+        }
+    }
+
+    Rule Rule::life() {
+        return well_known_rules[0].rule;
+    }
+
+    Rule Rule::parse(const std::string &text) {
+        std::string key = normalised(text);
+
+        for (const NamedRule &named : well_known_rules) {
+            if (key == normalised(named.name)) {
+                return named.rule;
+            }
+        }
+
+        std::string notation;
+        for (char c : text) {
+            if (!isspace(static_cast<unsigned char>(c))) {
+                notation += static_cast<char>(toupper(static_cast<unsigned char>(c)));
+            }
+        }
+
+        if (notation.size() > 1 && notation[0] == 'R' && isdigit(static_cast<unsigned char>(notation[1]))) {
+            Rule rule = parseLargerThanLife(notation, text);
+            rule.check();
+            return rule;
+        }
+
+        Rule rule(0, 0);
+        size_t position = 0;
+
+        if (!notation.empty() && (notation[0] == 'B' || notation[0] == 'S')) {
+            // B and S parts in either order, with or without a slash in between,
+            // then the states, with or without a C
+            bool seen[2] = { false, false };
+
+            while (position < notation.size() && !(seen[0] && seen[1])) {
+                bool birth = notation[position] == 'B';
+                if ((!birth && notation[position] != 'S') || seen[birth]) {
+                    throw unsupported("Unable to parse rule!", text);
+                }
+                seen[birth] = true;
+
+                position++;
+                (birth ? rule.birth : rule.survival) = counts(notation, position);
+
+                if (position < notation.size() && notation[position] == '/' && ++position == notation.size()) {
+                    throw unsupported("Unable to parse rule!", text);
+                }
+            }
+
+            if (!seen[0] || !seen[1]) {
+                throw unsupported("Unable to parse rule!", text);
+            }
+
+            if (position < notation.size()) {
+                position += notation[position] == 'C';
+                rule.states = number(notation, position, text);
+            }
+        } else {
+            // S/B, or S/B/C
+            rule.survival = counts(notation, position);
+            if (position >= notation.size() || notation[position] != '/') {
+                throw unsupported("Unable to parse rule!", text);
+            }
+            position++;
+            rule.birth = counts(notation, position);
+
+            if (position < notation.size() && notation[position] == '/') {
+                position++;
+                rule.states = number(notation, position, text);
+            }
+        }
+
+        if (position != notation.size()) {
+            throw unsupported("Unable to parse rule!", text);
+        }
+
+        rule.check();
+        return rule;
+    }
+
+    void Rule::check() const {
+        if (range == 1 ? birth & 1 : birth_min == 0 && birth_max >= birth_min) {
+            throw unsupported("Unsupported rule, B0 would bring dead space alive!", toString());
+        }
+
+        if (states < 2 || states > 256 || range == 0 || range > max_range) {
+            throw unsupported("Unsupported rule, states or range out of bounds!", toString());
+        }
+    }
+
+    std::string Rule::toString() const {
+        if (range > 1) {
+            return "R" + std::to_string(range) + ",C" + std::to_string(states > 2 ? states : 0) +
+                   ",M0,S" + std::to_string(survival_min) + ".." + std::to_string(survival_max) +
+                   ",B" + std::to_string(birth_min) + ".." + std::to_string(birth_max) + ",NM";
+        }
+
+        std::string result = "B";
+        for (unsigned n = 0; n <= 8; n++) {
+            if ((birth >> n) & 1) {
+                result += static_cast<char>('0' + n);
+            }
+        }
+
+        result += "/S";
+        for (unsigned n = 0; n <= 8; n++) {
+            if ((survival >> n) & 1) {
+                result += static_cast<char>('0' + n);
+            }
+        }
+
+        if (states > 2) {
+            result += "/C" + std::to_string(states);
+        }
+
+        return result;
+    }
+
+    std::string Rule::name() const {
+        for (const NamedRule &named : well_known_rules) {
+            if (named.rule == *this) {
+                return named.name;
+            }
+        }
+        return toString();
+    }
+
+    uint32_t Rule::bits() const {
+        return birth | (uint32_t(survival) << 9);
+    }
+
+    Rule Rule::fromBits(uint32_t bits) {
+        return Rule(static_cast<uint16_t>(bits & 0x1FF), static_cast<uint16_t>((bits >> 9) & 0x1FF));
+    }
+}
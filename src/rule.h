@@ -0,0 +1,128 @@
+#ifndef RULE_H
+#define RULE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace RainbowLife {
+    // a rule of the simulation
+    //
+    // Life-like rules (range 1): bit n of birth is set if a dead cell with n
+    // living neighbours (0 to 8) is born, bit n of survival if a living one
+    // stays alive. the simulation never interprets these cell by cell, it
+    // compiles them into a kernel first, see Kernel::compile().
+    //
+    // Generations rules (more than 2 states): a living cell that doesn't
+    // survive goes through states - 2 dying states before it's dead. dying
+    // cells count as dead for their neighbours, but can't be born.
+    //
+    // Larger than Life rules (range 2 to max_range): the neighbourhood is
+    // the (2 * range + 1)^2 square around the cell, without the cell itself,
+    // and births and survival take a count within [min, max] (both
+    // intervals empty if min > max). they can have more states as well.
+    struct Rule {
+        uint16_t birth, survival;
+        uint16_t states;
+        uint16_t range;
+        uint16_t birth_min, birth_max, survival_min, survival_max;
+
+        // counts of the widest range still fit 16 bits
+        static const uint16_t max_range = 100;
+
+        constexpr Rule() :
+            birth(0), survival(0), states(2), range(1),
+            birth_min(0), birth_max(0), survival_min(0), survival_max(0) {}
+
+        constexpr Rule(uint16_t birth, uint16_t survival, uint16_t states = 2) :
+            birth(birth), survival(survival), states(states), range(1),
+            birth_min(0), birth_max(0), survival_min(0), survival_max(0) {}
+
+        // a Larger than Life rule
+        constexpr Rule(uint16_t range, uint16_t states,
+                       uint16_t birth_min, uint16_t birth_max, uint16_t survival_min, uint16_t survival_max) :
+            birth(0), survival(0), states(states), range(range),
+            birth_min(birth_min), birth_max(birth_max), survival_min(survival_min), survival_max(survival_max) {}
+
+        // B3/S23
+        static Rule life();
+
+        // B/S notation ("B36/S23", any case) with an optional number of
+        // states ("B2/S/C3" or "B2/S/3"), S/B notation ("23/3", "345/2/4"),
+        // the notation of Golly for Larger than Life ("R5,C0,M1,S34..58,B34..45,NM",
+        // with M1 the cell itself is counted as well), or the name of a well
+        // known rule ("HighLife", see well_known_rules)
+        // throws std::runtime_error otherwise, or if check() does
+        static Rule parse(const std::string &text);
+
+        // throws std::runtime_error for rules with B0 (dead space would come
+        // alive everywhere at once, which neither the tile skipping of Grid
+        // nor HashLife can follow), and for states or ranges out of bounds
+        void check() const;
+
+        // two states, range 1, what HashLife and Rule::bits() can take
+        bool isLifeLike() const {
+            return states == 2 && range == 1;
+        }
+
+        // in B/S(/C) notation, or the one of Golly for Larger than Life (with M0)
+        std::string toString() const;
+
+        // name of the rule if it is a well known one, otherwise toString()
+        std::string name() const;
+
+        // whether a cell lives in the next generation (dying cells are dead here)
+        bool next(bool alive, unsigned neighbours) const {
+            if (range == 1) {
+                return ((alive ? survival : birth) >> neighbours) & 1;
+            }
+            return alive ? neighbours >= survival_min && neighbours <= survival_max
+                         : neighbours >= birth_min && neighbours <= birth_max;
+        }
+
+        // 18 bits, birth in the low 9, for file headers (Life-like rules only)
+        uint32_t bits() const;
+        static Rule fromBits(uint32_t bits);
+
+        bool operator==(const Rule &other) const {
+            return birth == other.birth && survival == other.survival &&
+                   states == other.states && range == other.range &&
+                   birth_min == other.birth_min && birth_max == other.birth_max &&
+                   survival_min == other.survival_min && survival_max == other.survival_max;
+        }
+
+        bool operator!=(const Rule &other) const {
+            return !(*this == other);
+        }
+    };
+
+    struct NamedRule {
+        const char *name;
+        Rule rule;
+    };
+
+    // Life first, every Life-like one of these (Generations included) gets
+    // a kernel of its own, see Kernel::compile()
+    constexpr NamedRule well_known_rules[] = {
+        { "Life", Rule(0x008, 0x00C) },                   // B3/S23
+        { "HighLife", Rule(0x048, 0x00C) },               // B36/S23
+        { "Day & Night", Rule(0x1C8, 0x1D8) },            // B3678/S34678
+        { "Seeds", Rule(0x004, 0x000) },                  // B2/S
+        { "Life without Death", Rule(0x008, 0x1FF) },     // B3/S012345678
+        { "2x2", Rule(0x048, 0x026) },                    // B36/S125
+        { "34 Life", Rule(0x018, 0x018) },                // B34/S34
+        { "Maze", Rule(0x008, 0x03E) },                   // B3/S12345
+        { "Diamoeba", Rule(0x1E8, 0x1E0) },               // B35678/S5678
+        { "Morley", Rule(0x148, 0x034) },                 // B368/S245
+        { "Anneal", Rule(0x1D0, 0x1E8) },                 // B4678/S35678
+        { "Replicator", Rule(0x0AA, 0x0AA) },             // B1357/S1357
+        { "Brian's Brain", Rule(0x004, 0x000, 3) },       // B2/S/C3
+        { "Star Wars", Rule(0x004, 0x038, 4) },           // B2/S345/C4
+        { "Bosco's Rule", Rule(5, 2, 34, 45, 33, 57) },   // R5,C0,M1,S34..58,B34..45,NM
+        { "Majority", Rule(4, 2, 41, 81, 40, 80) }        // R4,C0,M1,S41..81,B41..81,NM
+    };
+
+    constexpr size_t well_known_rule_count = sizeof(well_known_rules) / sizeof(well_known_rules[0]);
+}
+
+#endif /* RULE_H */
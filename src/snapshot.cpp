@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "snapshot.h"
+
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "snapshots are stored little endian, and read and written without conversion"
+#endif
+
+namespace RainbowLife {
+    namespace Snapshot {
+
+        namespace {
+            const char magic[8] = { 'R', 'A', 'I', 'N', 'B', 'O', 'W', 'L' };
+            const size_t alignment = 64;
+
+            size_t aligned(size_t offset) {
+                return (offset + alignment - 1) / alignment * alignment;
+            }
+
+            std::runtime_error error(const std::string &what, const std::string &path) {
+                return std::runtime_error(what + "\n" +
+                                          "    - file: " + path + "\n" +
+                                          "    - error: " + strerror(errno) + "\n");
+            }
+
+            // a mapped file, unmapped and closed when it goes out of scope
+            struct Mapping {
+                int file;
+                void *data;
+                size_t size;
+
+                Mapping() : file(-1), data(MAP_FAILED), size(0) {}
+
+                ~Mapping() {
+                    if (data != MAP_FAILED) {
+                        munmap(data, size);
+                    }
+                    if (file >= 0) {
+                        close(file);
+                    }
+                }
+            };
+
+            // offsets of the liveness and hue planes, the rule text and the
+            // dying states (if the flags have them), and the size of the whole file
+            // false if any of them overflows
+            bool layout(const Header &header, size_t &liveness, size_t &hues, size_t &rule, size_t &decay, size_t &size) {
+                size_t liveness_size, cells;
+                if (__builtin_mul_overflow(header.height, header.words_per_row, &liveness_size) ||
+                    __builtin_mul_overflow(liveness_size, sizeof(uint64_t), &liveness_size) ||
+                    __builtin_mul_overflow(header.width, header.height, &cells)) {
+                    return false;
+                }
+
+                liveness = aligned(sizeof(Header));
+                hues = aligned(liveness + liveness_size);
+                size = hues + cells;
+
+                rule = aligned(size);
+                decay = rule + rule_text_size;
+                if (header.flags & RULE_TEXT) {
+                    size = header.flags & DECAY ? decay + cells : decay;
+                }
+                return true;
+            }
+        }
+
+        static_assert(sizeof(Header) == 64, "the snapshot header is 64 bytes");
+
+        void save(const Frame &frame, const std::string &path) {
+            Header header;
+            memcpy(header.magic, magic, sizeof(magic));
+            header.version = version;
+            header.flags = (frame.wrap ? WRAPPING : 0) |
+                           (frame.rule.isLifeLike() ? RULE | frame.rule.bits() << rule_shift
+                                                    : RULE_TEXT | (frame.decay.empty() ? 0 : DECAY));
+            header.width = frame.width;
+            header.height = frame.height;
+            header.generation = frame.generation;
+            header.seed = frame.seed;
+            header.randomizations = frame.randomizations;
+            header.words_per_row = frame.words_per_row;
+            header.hue_bits = 8;
+
+            size_t liveness, hues, rule, decay;
+            Mapping mapping;
+            if (!layout(header, liveness, hues, rule, decay, mapping.size)) {
+                throw std::runtime_error(std::string("Unsupported snapshot dimensions!\n") +
+                                         "    - file: " + path + "\n" +
+                                         "    - dimensions: " + std::to_string(header.width) + "x" + std::to_string(header.height) + "\n");
+            }
+
+            std::string temporary = path + ".tmp";
+            mapping.file = open(temporary.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+            if (mapping.file < 0 || ftruncate(mapping.file, mapping.size) != 0) {
+                throw error("Unable to create snapshot!", temporary);
+            }
+
+            mapping.data = mmap(nullptr, mapping.size, PROT_READ | PROT_WRITE, MAP_SHARED, mapping.file, 0);
+
+            if (mapping.data == MAP_FAILED) {
+                throw error("Unable to map snapshot!", temporary);
+            }
+
+            uint8_t *data = static_cast<uint8_t*>(mapping.data);
+            memcpy(data, &header, sizeof(header));
+            memcpy(data + liveness, frame.cells.data(), frame.cells.size() * sizeof(uint64_t));
+
+            uint8_t *quantised = data + hues;
+            for (size_t cell = 0; cell < frame.hues.size(); cell++) {
+                quantised[cell] = frame.hues[cell] >> 8;
+            }
+
+            if (header.flags & RULE_TEXT) {
+                std::string text = frame.rule.toString();
+                memcpy(data + rule, text.data(), std::min(text.size(), rule_text_size - 1));
+            }
+
+            if (header.flags & DECAY) {
+                memcpy(data + decay, frame.decay.data(), frame.decay.size());
+            }
+
+            if (msync(mapping.data, mapping.size, MS_SYNC) != 0 || rename(temporary.c_str(), path.c_str()) != 0) {
+                throw error("Unable to write snapshot!", path);
+            }
+        }
+
+        void load(const std::string &path, Frame &frame) {
+            Mapping mapping;
+            struct stat status;
+
+            mapping.file = open(path.c_str(), O_RDONLY);
+
+            if (mapping.file < 0 || fstat(mapping.file, &status) != 0) {
+                throw error("Unable to open snapshot!", path);
+            }
+
+            mapping.size = status.st_size;
+
+            if (mapping.size < sizeof(Header)) {
+                throw std::runtime_error("Invalid snapshot, too short for its header!\n    - file: " + path + "\n");
+            }
+
+            mapping.data = mmap(nullptr, mapping.size, PROT_READ, MAP_PRIVATE, mapping.file, 0);
+
+            if (mapping.data == MAP_FAILED) {
+                throw error("Unable to map snapshot!", path);
+            }
+
+            madvise(mapping.data, mapping.size, MADV_SEQUENTIAL);
+
+            const uint8_t *data = static_cast<const uint8_t*>(mapping.data);
+            Header header;
+            memcpy(&header, data, sizeof(header));
+
+            if (memcmp(header.magic, magic, sizeof(magic)) != 0) {
+                throw std::runtime_error("Invalid snapshot, not a Rainbow Life snapshot!\n    - file: " + path + "\n");
+            }
+
+            if (header.version != version || header.hue_bits != 8) {
+                throw std::runtime_error(std::string("Unsupported snapshot version!\n") +
+                                         "    - file: " + path + "\n" +
+                                         "    - version: " + std::to_string(header.version) + "\n" +
+                                         "    - supported version: " + std::to_string(version) + "\n");
+            }
+
+            if (!Frame::validDimensions(header.width, header.height) || header.words_per_row != (header.width + 63) / 64) {
+                throw std::runtime_error(std::string("Invalid snapshot, unsupported dimensions!\n") +
+                                         "    - file: " + path + "\n" +
+                                         "    - dimensions: " + std::to_string(header.width) + "x" + std::to_string(header.height) + "\n" +
+                                         "    - words per row: " + std::to_string(header.words_per_row) + "\n");
+            }
+
+            size_t liveness, hues, rule, decay, size;
+
+            if (!layout(header, liveness, hues, rule, decay, size) || mapping.size < size) {
+                throw std::runtime_error(std::string("Invalid snapshot, truncated or inconsistent!\n") +
+                                         "    - file: " + path + "\n" +
+                                         "    - dimensions: " + std::to_string(header.width) + "x" + std::to_string(header.height) + "\n" +
+                                         "    - size: " + std::to_string(mapping.size) + " bytes\n" +
+                                         "    - expected size: " + std::to_string(size) + " bytes\n");
+            }
+
+            frame.width = header.width;
+            frame.height = header.height;
+            frame.words_per_row = header.words_per_row;
+            frame.generation = header.generation;
+            frame.wrap = header.flags & WRAPPING;
+            frame.rule = header.flags & RULE ? Rule::fromBits(header.flags >> rule_shift) : Rule::life();
+
+            if (header.flags & RULE_TEXT) {
+                const char *text = reinterpret_cast<const char*>(data + rule);
+
+                try {
+                    frame.rule = Rule::parse(std::string(text, strnlen(text, rule_text_size)));
+                } catch (const std::runtime_error &exception) {
+                    throw std::runtime_error(std::string("Invalid snapshot, unsupported rule!\n") +
+                                             "    - file: " + path + "\n" +
+                                             "    - error: " + exception.what());
+                }
+            }
+
+            frame.seed = header.seed;
+            frame.randomizations = header.randomizations;
+            frame.births = frame.deaths = frame.tick_nanoseconds = 0;
+
+            const uint64_t *cells = reinterpret_cast<const uint64_t*>(data + liveness);
+            frame.cells.assign(cells, cells + header.height * header.words_per_row);
+
+            // the bits after the end of a row have to stay zero
+            if (header.width % 64 != 0) {
+                uint64_t row_mask = (uint64_t(1) << (header.width % 64)) - 1;
+
+                for (size_t y = 0; y < header.height; y++) {
+                    frame.cells[(y + 1) * header.words_per_row - 1] &= row_mask;
+                }
+            }
+
+            frame.population = 0;
+            for (uint64_t word : frame.cells) {
+                frame.population += __builtin_popcountll(word);
+            }
+
+            // every quantised hue stands for the middle of its range
+            const uint8_t *quantised = data + hues;
+            frame.hues.resize(header.width * header.height);
+            for (size_t cell = 0; cell < frame.hues.size(); cell++) {
+                frame.hues[cell] = (quantised[cell] << 8) | 0x80;
+            }
+
+            if (header.flags & DECAY) {
+                frame.decay.assign(data + decay, data + decay + header.width * header.height);
+            } else {
+                frame.decay.clear();
+            }
+        }
+    }
+};
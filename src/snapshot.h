@@ -0,0 +1,55 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstdint>
+#include <string>
+#include "frame.hpp"
+
+namespace RainbowLife {
+    // binary snapshots of a whole board, read and written through mmap
+    //
+    // layout (little endian), every part starting on a 64 byte boundary:
+    //  - Header
+    //  - liveness: height rows of words_per_row 64 bit words, in the bit
+    //    layout of Grid (cell x of a row is bit x % 64 of word x / 64)
+    //  - hues: width * height bytes, row by row, the top 8 bits of every Hue
+    //  - with RULE_TEXT, the rule as in Rule::toString(), in rule_text_size
+    //    bytes padded with zeroes, and right after it with DECAY, the dying
+    //    state of every cell (see Frame::decay), width * height bytes
+    namespace Snapshot {
+        const uint32_t version = 1;
+
+        struct Header {
+            char magic[8];
+            uint32_t version;
+            uint32_t flags;
+            uint64_t width, height;
+            uint64_t generation;
+            uint64_t seed, randomizations;
+            uint32_t words_per_row;
+            uint32_t hue_bits;
+        };
+
+        // with RULE, the bits from rule_shift on are Rule::bits(), without it
+        // (or RULE_TEXT, for rules that aren't Life-like) the rule is Life
+        enum Flags : uint32_t {
+            WRAPPING = 1,
+            RULE = 2,
+            RULE_TEXT = 4,
+            DECAY = 8
+        };
+
+        const unsigned rule_shift = 8;
+        const size_t rule_text_size = 64;
+
+        // writes frame to path (through a temporary file, so path is never half written)
+        void save(const Frame &frame, const std::string &path);
+
+        // reads path into frame, reusing its memory
+        // throws for files that are truncated, or have dimensions outside
+        // Frame::validDimensions(), before reading anything past the header
+        void load(const std::string &path, Frame &frame);
+    }
+}
+
+#endif /* SNAPSHOT_H */
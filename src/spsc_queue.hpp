@@ -0,0 +1,62 @@
+#ifndef SPSC_QUEUE_HPP
+#define SPSC_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+
+namespace RainbowLife {
+    // lock-free bounded queue between a single producer and a single consumer thread
+    //
+    // capacity has to be a power of two. the two indices only ever grow (and
+    // wrap around together), each side writes its own and reads the other's.
+    template <typename T, size_t capacity>
+    class SpscQueue {
+    private:
+        static_assert(capacity > 0 && (capacity & (capacity - 1)) == 0, "capacity has to be a power of two");
+
+        T items[capacity];
+
+        // kept a cache line apart, so the two sides don't keep stealing it from each other
+        std::atomic<size_t> head;
+        char padding[64 - sizeof(std::atomic<size_t>)];
+        std::atomic<size_t> tail;
+
+    public:
+        SpscQueue() : head(0), tail(0) {}
+
+        SpscQueue(const SpscQueue&) = delete;
+        SpscQueue& operator=(const SpscQueue&) = delete;
+
+        // producer side, false if the queue is full
+        bool push(const T &item) {
+            size_t position = tail.load(std::memory_order_relaxed);
+
+            if (position - head.load(std::memory_order_acquire) == capacity) {
+                return false;
+            }
+
+            items[position & (capacity - 1)] = item;
+            tail.store(position + 1, std::memory_order_release);
+            return true;
+        }
+
+        // consumer side, false if the queue is empty
+        bool pop(T &item) {
+            size_t position = head.load(std::memory_order_relaxed);
+
+            if (position == tail.load(std::memory_order_acquire)) {
+                return false;
+            }
+
+            item = items[position & (capacity - 1)];
+            head.store(position + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool empty() const {
+            return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+        }
+    };
+}
+
+#endif /* SPSC_QUEUE_HPP */
@@ -0,0 +1,106 @@
+#include "thread_pool.h"
+
+namespace RainbowLife {
+
+    ThreadPool::ThreadPool(size_t threads) :
+        job(nullptr),
+        task_count(0),
+        generation(0),
+        busy(0),
+        stopping(false),
+        next_task(0)
+    {
+        if (threads == 0) {
+            threads = std::thread::hardware_concurrency();
+        }
+
+        for (size_t i = 1; i < threads; i++) {
+            workers.emplace_back(&ThreadPool::work, this);
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+
+        for (std::thread &worker : workers) {
+            worker.join();
+        }
+    }
+
+    size_t ThreadPool::size() const {
+        return workers.size() + 1;
+    }
+
+    void ThreadPool::runTasks(Job *job, size_t task_count) {
+        size_t task;
+        while ((task = next_task.fetch_add(1)) < task_count) {
+            job->run(task);
+        }
+    }
+
+    void ThreadPool::work() {
+        size_t seen_generation = 0;
+
+        while (true) {
+            Job *current_job;
+            size_t current_task_count;
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&]() { return stopping || generation != seen_generation; });
+
+                if (stopping) {
+                    return;
+                }
+
+                seen_generation = generation;
+                current_job = job;
+                current_task_count = task_count;
+
+                // woke up too late, the job is already done
+                if (current_job == nullptr) {
+                    continue;
+                }
+
+                busy++;
+            }
+
+            runTasks(current_job, current_task_count);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                busy--;
+            }
+            done.notify_one();
+        }
+    }
+
+    void ThreadPool::run(Job &job, size_t task_count) {
+        if (workers.empty() || task_count < 2) {
+            for (size_t task = 0; task < task_count; task++) {
+                job.run(task);
+            }
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            this->job = &job;
+            this->task_count = task_count;
+            next_task = 0;
+            generation++;
+        }
+        wake.notify_all();
+
+        runTasks(&job, task_count);
+
+        // every task is taken at this point, waiting for the workers still running one
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&]() { return busy == 0; });
+        this->job = nullptr;
+    }
+}
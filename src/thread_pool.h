@@ -0,0 +1,72 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace RainbowLife {
+    // persistent worker threads for data parallel jobs
+    //
+    // the threads are started once, and sleep between jobs, so running a
+    // job (like a tick) doesn't spawn anything. the calling thread takes
+    // tasks too, a pool of N threads has N-1 workers.
+    class ThreadPool {
+    public:
+        class Job {
+        public:
+            virtual void run(size_t task) = 0;
+            virtual ~Job() {}
+        };
+
+    private:
+        template <typename Function>
+        class FunctionJob : public Job {
+        private:
+            Function &function;
+
+        public:
+            FunctionJob(Function &function) : function(function) {}
+            void run(size_t task) { function(task); }
+        };
+
+        std::vector<std::thread> workers;
+
+        // current job, guarded by mutex
+        std::mutex mutex;
+        std::condition_variable wake, done;
+        Job *job;
+        size_t task_count, generation, busy;
+        bool stopping;
+
+        std::atomic<size_t> next_task;
+
+        void runTasks(Job *job, size_t task_count);
+        void work();
+
+    public:
+        // 0 threads means one per hardware thread
+        ThreadPool(size_t threads = 0);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        // number of threads taking tasks, including the caller of run()
+        size_t size() const;
+
+        // runs tasks 0..task_count-1 of job, and returns when all of them are done
+        void run(Job &job, size_t task_count);
+
+        template <typename Function>
+        void run(size_t task_count, Function function) {
+            FunctionJob<Function> job(function);
+            run(job, task_count);
+        }
+    };
+}
+
+#endif /* THREAD_POOL_H */
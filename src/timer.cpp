@@ -10,4 +10,8 @@ void Timer::stop() {
 
 std::chrono::milliseconds::rep Timer::duration() {
     return std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count();
-}
\ No newline at end of file
+}
+
+std::chrono::nanoseconds::rep Timer::nanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+}
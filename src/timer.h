@@ -12,6 +12,7 @@ public:
     void stop();
 
     std::chrono::milliseconds::rep duration();
+    std::chrono::nanoseconds::rep nanoseconds();
 };
 
-#endif /* TIMER_H */
\ No newline at end of file
+#endif /* TIMER_H */
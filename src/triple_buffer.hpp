@@ -0,0 +1,62 @@
+#ifndef TRIPLE_BUFFER_HPP
+#define TRIPLE_BUFFER_HPP
+
+#include <atomic>
+
+namespace RainbowLife {
+    // lock-free handoff of the latest value from one producer thread to one consumer thread
+    //
+    // the producer fills back() and publishes it, the consumer picks up the
+    // latest published value with update() and reads it through front().
+    // neither side ever waits: values published between two update() calls
+    // are simply skipped, the consumer always sees the newest one.
+    template <typename T>
+    class TripleBuffer {
+    private:
+        T buffers[3];
+
+        // index of the buffer between the two sides, plus fresh_bit if it was
+        // published after the consumer last picked one up
+        static const unsigned fresh_bit = 4, index_mask = 3;
+        std::atomic<unsigned> middle;
+
+        // owned by the producer and the consumer
+        unsigned back_index, front_index;
+
+    public:
+        TripleBuffer() : middle(1), back_index(0), front_index(2) {}
+
+        TripleBuffer(const TripleBuffer&) = delete;
+        TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+        // producer side
+        T& back() {
+            return buffers[back_index];
+        }
+
+        void publish() {
+            back_index = middle.exchange(back_index | fresh_bit, std::memory_order_acq_rel) & index_mask;
+        }
+
+        // whether the consumer hasn't picked up the last published value yet
+        bool pending() const {
+            return middle.load(std::memory_order_acquire) & fresh_bit;
+        }
+
+        // consumer side, returns whether front() changed
+        bool update() {
+            if (!(middle.load(std::memory_order_acquire) & fresh_bit)) {
+                return false;
+            }
+
+            front_index = middle.exchange(front_index, std::memory_order_acq_rel) & index_mask;
+            return true;
+        }
+
+        const T& front() const {
+            return buffers[front_index];
+        }
+    };
+}
+
+#endif /* TRIPLE_BUFFER_HPP */
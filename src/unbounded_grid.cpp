@@ -0,0 +1,445 @@
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include "random.hpp"
+#include "unbounded_grid.h"
+
+namespace RainbowLife {
+
+    namespace {
+        const size_t initial_slots = 64;
+
+        // chunk of a cell coordinate, rounding down for negative ones too
+        inline int64_t chunkOf(int64_t cell) {
+            return cell >= 0 ? cell / 64 : -((-cell + 63) / 64);
+        }
+
+        inline bool inRange(int64_t x, int64_t y) {
+            return x >= INT32_MIN && x <= INT32_MAX && y >= INT32_MIN && y <= INT32_MAX;
+        }
+
+        // the cells of a window word with count cells
+        inline UnboundedGrid::Word cellMask(size_t count) {
+            return count >= 64 ? ~UnboundedGrid::Word(0) : (UnboundedGrid::Word(1) << count) - 1;
+        }
+    }
+
+    const size_t UnboundedGrid::chunk_size;
+
+    UnboundedGrid::UnboundedGrid() :
+        plane(0),
+        table(initial_slots, nullptr),
+        row_chunks_y(INT64_MIN)
+    {
+    }
+
+    size_t UnboundedGrid::slot(int64_t x, int64_t y) const {
+        uint64_t key = (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y);
+        return Random::mix(key) & (table.size() - 1);
+    }
+
+    UnboundedGrid::Chunk* UnboundedGrid::find(int64_t x, int64_t y) const {
+        if (!inRange(x, y)) {
+            return nullptr;
+        }
+
+        for (size_t i = slot(x, y);; i = (i + 1) & (table.size() - 1)) {
+            Chunk *chunk = table[i];
+            if (!chunk || (chunk->x == x && chunk->y == y)) {
+                return chunk;
+            }
+        }
+    }
+
+    UnboundedGrid::Chunk* UnboundedGrid::create(int64_t x, int64_t y) {
+        if (!inRange(x, y)) {
+            return nullptr;
+        }
+
+        // rehashed into twice the slots when half of them are used
+        if ((chunks.size() + 1) * 2 > table.size()) {
+            std::vector<Chunk*> old_table(table.size() * 2, nullptr);
+            table.swap(old_table);
+
+            for (Chunk *chunk : old_table) {
+                if (chunk) {
+                    size_t i = slot(chunk->x, chunk->y);
+                    while (table[i]) {
+                        i = (i + 1) & (table.size() - 1);
+                    }
+                    table[i] = chunk;
+                }
+            }
+        }
+
+        Chunk *chunk = chunk_pool.acquire();
+        chunk->x = static_cast<int32_t>(x);
+        chunk->y = static_cast<int32_t>(y);
+        std::memset(chunk->cells, 0, sizeof(chunk->cells));
+        std::memset(chunk->hues, 0, sizeof(chunk->hues));
+        chunk->index = chunks.size();
+        chunk->changed = chunk->changed_next = chunk->active = false;
+        chunk->empty = true;
+
+        size_t i = slot(x, y);
+        while (table[i]) {
+            i = (i + 1) & (table.size() - 1);
+        }
+        table[i] = chunk;
+        chunks.push_back(chunk);
+
+        return chunk;
+    }
+
+    void UnboundedGrid::remove(Chunk *chunk) {
+        const size_t mask = table.size() - 1;
+
+        size_t hole = slot(chunk->x, chunk->y);
+        while (table[hole] != chunk) {
+            hole = (hole + 1) & mask;
+        }
+        table[hole] = nullptr;
+
+        // moves later chunks of the probe sequence back into the hole, unless
+        // that would put them before their own slot
+        for (size_t i = (hole + 1) & mask; table[i]; i = (i + 1) & mask) {
+            size_t home = slot(table[i]->x, table[i]->y);
+
+            if (((i - home) & mask) >= ((i - hole) & mask)) {
+                table[hole] = table[i];
+                table[i] = nullptr;
+                hole = i;
+            }
+        }
+
+        chunks[chunk->index] = chunks.back();
+        chunks[chunk->index]->index = chunk->index;
+        chunks.pop_back();
+
+        chunk_pool.release(chunk);
+    }
+
+    void UnboundedGrid::clear() {
+        for (Chunk *chunk : chunks) {
+            chunk_pool.release(chunk);
+        }
+        chunks.clear();
+        active_chunks.clear();
+        std::fill(table.begin(), table.end(), nullptr);
+    }
+
+    void UnboundedGrid::windowRow(int64_t x, int64_t y, size_t words, unsigned &shift, unsigned &chunk_row) {
+        int64_t chunk_x = chunkOf(x), chunk_y = chunkOf(y);
+        shift = static_cast<unsigned>(x - chunk_x * 64);
+        chunk_row = static_cast<unsigned>(y - chunk_y * 64);
+
+        // word i of the window starts in chunk chunk_x + i, and ends in the next one
+        if (chunk_y != row_chunks_y) {
+            row_chunks.resize(words + 1);
+            for (size_t i = 0; i <= words; i++) {
+                row_chunks[i] = find(chunk_x + static_cast<int64_t>(i), chunk_y);
+            }
+            row_chunks_y = chunk_y;
+        }
+    }
+
+    void UnboundedGrid::load(const Word *cells, const Hue *hues, size_t width, size_t height, int64_t x, int64_t y) {
+        const size_t words = (width + 63) / 64;
+        row_chunks_y = INT64_MIN;
+
+        for (size_t row = 0; row < height; row++) {
+            unsigned shift, chunk_row;
+            windowRow(x, y + static_cast<int64_t>(row), words, shift, chunk_row);
+
+            for (size_t word = 0; word < words; word++) {
+                Word mask = cellMask(width - word * 64),
+                     bits = cells[row * words + word] & mask;
+
+                // the part in the chunk the word starts in, then the part in the next one
+                for (size_t part = 0; part < 2; part++) {
+                    Word part_mask = part == 0 ? mask << shift : shift ? mask >> (64 - shift) : 0,
+                         part_bits = part == 0 ? bits << shift : shift ? bits >> (64 - shift) : 0;
+
+                    if (!part_mask) {
+                        continue;
+                    }
+
+                    Chunk *&chunk = row_chunks[word + part];
+                    if (!chunk && part_bits) {
+                        chunk = create(chunkOf(x) + static_cast<int64_t>(word + part), row_chunks_y);
+                    }
+                    if (!chunk) {
+                        continue;
+                    }
+
+                    Word &chunk_word = chunk->cells[plane][chunk_row];
+                    if ((chunk_word & part_mask) != part_bits) {
+                        chunk_word = (chunk_word & ~part_mask) | part_bits;
+                        chunk->changed = true;
+                    }
+
+                    size_t first = part == 0 ? 0 : 64 - shift,
+                           chunk_x = part == 0 ? shift : 0;
+                    std::memcpy(chunk->hues + chunk_row * 64 + chunk_x,
+                                hues + row * width + word * 64 + first,
+                                __builtin_popcountll(part_mask) * sizeof(Hue));
+                }
+            }
+        }
+    }
+
+    void UnboundedGrid::store(Word *cells, Hue *hues, size_t width, size_t height, int64_t x, int64_t y) {
+        const size_t words = (width + 63) / 64;
+        row_chunks_y = INT64_MIN;
+
+        for (size_t row = 0; row < height; row++) {
+            unsigned shift, chunk_row;
+            windowRow(x, y + static_cast<int64_t>(row), words, shift, chunk_row);
+
+            for (size_t word = 0; word < words; word++) {
+                const Chunk *first = row_chunks[word], *second = shift ? row_chunks[word + 1] : nullptr;
+                size_t count = std::min<size_t>(64, width - word * 64),
+                       first_count = std::min<size_t>(count, 64 - shift);
+                Hue *hue = hues + row * width + word * 64;
+
+                Word bits = 0;
+                if (first) {
+                    bits |= first->cells[plane][chunk_row] >> shift;
+                    std::memcpy(hue, first->hues + chunk_row * 64 + shift, first_count * sizeof(Hue));
+                }
+                if (second) {
+                    bits |= second->cells[plane][chunk_row] << (64 - shift);
+                    if (count > first_count) {
+                        std::memcpy(hue + first_count, second->hues + chunk_row * 64, (count - first_count) * sizeof(Hue));
+                    }
+                }
+
+                cells[row * words + word] = bits & cellMask(count);
+            }
+        }
+    }
+
+    void UnboundedGrid::storeChanges(Word *cells, Hue *hues, size_t width, size_t height, int64_t x, int64_t y,
+                                     uint8_t *changed_tiles, uint64_t &births, uint64_t &deaths) {
+        const size_t words = (width + 63) / 64;
+        row_chunks_y = INT64_MIN;
+
+        for (size_t row = 0; row < height; row++) {
+            unsigned shift, chunk_row;
+            windowRow(x, y + static_cast<int64_t>(row), words, shift, chunk_row);
+
+            for (size_t word = 0; word < words; word++) {
+                const Chunk *first = row_chunks[word], *second = shift ? row_chunks[word + 1] : nullptr;
+
+                Word bits = (first ? first->cells[plane][chunk_row] >> shift : 0) |
+                            (second ? second->cells[plane][chunk_row] << (64 - shift) : 0);
+                bits &= cellMask(width - word * 64);
+
+                Word &window_word = cells[row * words + word];
+                if (bits == window_word) {
+                    continue;
+                }
+
+                Word born = bits & ~window_word;
+                births += __builtin_popcountll(born);
+                deaths += __builtin_popcountll(window_word & ~bits);
+                window_word = bits;
+                changed_tiles[row / 64 * words + word] = 1;
+
+                while (born) {
+                    unsigned cell = __builtin_ctzll(born);
+                    born &= born - 1;
+
+                    hues[row * width + word * 64 + cell] = cell < 64 - shift
+                        ? first->hues[chunk_row * 64 + shift + cell]
+                        : second->hues[chunk_row * 64 + cell - (64 - shift)];
+                }
+            }
+        }
+    }
+
+    void UnboundedGrid::tickChunk(Chunk &chunk, const Kernel::Compiled &kernel, uint64_t mutation_key, Hue max_mutation) {
+        Chunk *const *neighbours = chunk.neighbours;
+
+        // rows -1 to 64 of the chunk, with the words of the chunks left and right of it
+        Word rows[chunk_size + 2][3];
+        for (size_t row = 0; row < chunk_size + 2; row++) {
+            size_t neighbour_row = row == 0 ? 0 : row == chunk_size + 1 ? 2 : 1,
+                   chunk_row = (row + chunk_size - 1) % chunk_size;
+
+            for (size_t column = 0; column < 3; column++) {
+                const Chunk *neighbour = neighbours[neighbour_row * 3 + column];
+                rows[row][column] = neighbour ? neighbour->cells[plane][chunk_row] : 0;
+            }
+        }
+
+        // liveness and hue of cell x, y of the 3 x 3 chunks, x and y from -1 to 64
+        auto alive = [&rows](int x, int y) {
+            return (rows[y + 1][(x + 64) / 64] >> ((x + 64) % 64)) & 1;
+        };
+        auto hue = [neighbours](int x, int y) {
+            const Chunk *neighbour = neighbours[(y < 0 ? 0 : y < 64 ? 1 : 2) * 3 + (x < 0 ? 0 : x < 64 ? 1 : 2)];
+            return neighbour->hues[((y + 64) % 64) * 64 + (x + 64) % 64];
+        };
+
+        Word next_row[3], any_alive = 0;
+        chunk.changed_next = false;
+
+        for (size_t y = 0; y < chunk_size; y++) {
+            Kernel::stepRow(kernel, rows[y], rows[y + 1], rows[y + 2], next_row, 3 * 64, false, 1, 2);
+
+            Word old_word = rows[y + 1][1], new_word = next_row[1];
+            chunk.cells[plane ^ 1][y] = new_word;
+            any_alive |= new_word;
+
+            if (new_word == old_word) {
+                continue;
+            }
+            chunk.changed_next = true;
+
+            // hue inheritance as on Grid, from the living neighbours
+            for (Word born = new_word & ~old_word; born; born &= born - 1) {
+                int x = __builtin_ctzll(born);
+                Hue inherited_color = 0;
+                bool color_undefined = true;
+
+                for (int dx = -1; dx <= 1; dx++) {
+                    for (int dy = -1; dy <= 1; dy++) {
+                        if ((dx != 0 || dy != 0) && alive(x + dx, static_cast<int>(y) + dy)) {
+                            Hue neighbour_color = hue(x + dx, static_cast<int>(y) + dy);
+
+                            inherited_color = color_undefined ? neighbour_color : average_hue(inherited_color, neighbour_color);
+                            color_undefined = false;
+                        }
+                    }
+                }
+
+                uint64_t plane_x = static_cast<uint64_t>(int64_t(chunk.x) * 64 + x),
+                         plane_y = static_cast<uint64_t>(int64_t(chunk.y) * 64 + static_cast<int64_t>(y));
+                Hue mutation = Random::cell(mutation_key, plane_x, plane_y) % (max_mutation + 1);
+
+                chunk.hues[y * 64 + x] = inherited_color + mutation - max_mutation / 2;
+            }
+        }
+
+        chunk.empty = !any_alive;
+    }
+
+    void UnboundedGrid::tick(const Kernel::Compiled &kernel, uint64_t mutation_key, Hue max_mutation, ThreadPool &pool) {
+        // a changed chunk activates itself and its neighbours
+        for (Chunk *chunk : chunks) {
+            chunk->active = false;
+        }
+        for (Chunk *chunk : chunks) {
+            for (int dy = -1; chunk->changed && dy <= 1; dy++) {
+                for (int dx = -1; dx <= 1; dx++) {
+                    Chunk *neighbour = find(int64_t(chunk->x) + dx, int64_t(chunk->y) + dy);
+                    if (neighbour) {
+                        neighbour->active = true;
+                    }
+                }
+            }
+        }
+
+        // active chunks with living cells on an edge need the chunks beyond
+        // it (only the corner cells reach diagonally)
+        active_chunks.clear();
+        for (size_t i = 0, count = chunks.size(); i < count; i++) {
+            Chunk *chunk = chunks[i];
+            if (!chunk->active) {
+                continue;
+            }
+            active_chunks.push_back(chunk);
+
+            const Word *cells = chunk->cells[plane];
+            Word west = 0, east = 0;
+            for (size_t row = 0; row < chunk_size; row++) {
+                west |= cells[row] & 1;
+                east |= cells[row] >> 63;
+            }
+
+            bool reaches[3][3] = {
+                { (cells[0] & 1) != 0, cells[0] != 0, (cells[0] >> 63) != 0 },
+                { west != 0, false, east != 0 },
+                { (cells[63] & 1) != 0, cells[63] != 0, (cells[63] >> 63) != 0 }
+            };
+
+            for (int dy = -1; dy <= 1; dy++) {
+                for (int dx = -1; dx <= 1; dx++) {
+                    int64_t x = int64_t(chunk->x) + dx, y = int64_t(chunk->y) + dy;
+
+                    if (reaches[dy + 1][dx + 1] && !find(x, y)) {
+                        Chunk *created = create(x, y);
+                        if (created) {
+                            created->active = true;
+                            active_chunks.push_back(created);
+                        }
+                    }
+                }
+            }
+        }
+
+        for (Chunk *chunk : active_chunks) {
+            for (int dy = -1; dy <= 1; dy++) {
+                for (int dx = -1; dx <= 1; dx++) {
+                    chunk->neighbours[(dy + 1) * 3 + dx + 1] = find(int64_t(chunk->x) + dx, int64_t(chunk->y) + dy);
+                }
+            }
+        }
+
+        // every chunk reads the current plane of the chunks around it, and
+        // writes its own next plane, and the hues of its own newborn cells
+        pool.run(active_chunks.size(), [&](size_t i) {
+            tickChunk(*active_chunks[i], kernel, mutation_key, max_mutation);
+        });
+
+        // inactive chunks didn't change, and hold their next generation in both planes already
+        plane ^= 1;
+        for (Chunk *chunk : chunks) {
+            chunk->changed = chunk->active && chunk->changed_next;
+        }
+
+        // empty chunks go back to the pool, the ones that just emptied keep
+        // their neighbours active for another tick, as if they were still there
+        for (Chunk *chunk : active_chunks) {
+            if (!chunk->empty) {
+                continue;
+            }
+
+            for (int dy = -1; chunk->changed && dy <= 1; dy++) {
+                for (int dx = -1; dx <= 1; dx++) {
+                    Chunk *neighbour = find(int64_t(chunk->x) + dx, int64_t(chunk->y) + dy);
+                    if (neighbour) {
+                        neighbour->changed = true;
+                    }
+                }
+            }
+
+            remove(chunk);
+        }
+    }
+
+    uint64_t UnboundedGrid::population() const {
+        uint64_t population = 0;
+
+        for (const Chunk *chunk : chunks) {
+            for (size_t row = 0; row < chunk_size; row++) {
+                population += __builtin_popcountll(chunk->cells[plane][row]);
+            }
+        }
+
+        return population;
+    }
+
+    size_t UnboundedGrid::chunkCount() const {
+        return chunks.size();
+    }
+
+    size_t UnboundedGrid::activeChunkCount() const {
+        return active_chunks.size();
+    }
+
+    size_t UnboundedGrid::memoryUsage() const {
+        return chunk_pool.capacity() * sizeof(Chunk) + table.size() * sizeof(Chunk*);
+    }
+}
@@ -0,0 +1,117 @@
+#ifndef UNBOUNDED_GRID_H
+#define UNBOUNDED_GRID_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "hue.hpp"
+#include "kernel.h"
+#include "pool.hpp"
+#include "thread_pool.h"
+
+namespace RainbowLife {
+    // an unbounded plane of cells behind a Grid, see Grid::setUnbounded()
+    //
+    // the plane is split into chunks of 64 x 64 cells: a word per row (in the
+    // bit layout of Grid, with two planes) and a hue per cell. a chunk only
+    // exists while it has living cells, or is next to living cells on its
+    // edge: chunks are found by their coordinates in an open addressing hash
+    // table, taken from a Pool when activity reaches them, and given back as
+    // soon as they are empty, so memory follows the population, not the area
+    // it spreads over.
+    // like the tiles of Grid, a chunk is only computed if it, or one of its
+    // 8 neighbours changed in the previous tick.
+    //
+    // chunk coordinates are 32 bit: cells more than 2^37 away from the origin
+    // are lost. Life-like rules only (two states, range 1).
+    class UnboundedGrid {
+    public:
+        typedef uint64_t Word;
+        static const size_t chunk_size = 64;
+
+    private:
+        struct Chunk {
+            int32_t x, y;
+            Word cells[2][chunk_size];
+            Hue hues[chunk_size * chunk_size];
+
+            // position in chunks
+            size_t index;
+
+            // changed: in the last tick (or edited since), changed_next: in
+            // this one, empty: nothing alive after this one
+            bool changed, changed_next, active, empty;
+
+            // the 3 x 3 chunks around it (itself in the middle, nullptr where
+            // there is none), while it's computed
+            Chunk *neighbours[9];
+        };
+
+        // the current plane of every chunk
+        unsigned plane;
+
+        Pool<Chunk> chunk_pool;
+        std::vector<Chunk*> chunks, active_chunks;
+
+        // open addressing with linear probing, a power of two of slots, at
+        // most half of them used
+        std::vector<Chunk*> table;
+
+        size_t slot(int64_t x, int64_t y) const;
+        Chunk* find(int64_t x, int64_t y) const;
+
+        // an empty chunk, nullptr out of range
+        Chunk* create(int64_t x, int64_t y);
+        void remove(Chunk *chunk);
+
+        // the chunks of a window row, see windowRow()
+        std::vector<Chunk*> row_chunks;
+        int64_t row_chunks_y;
+
+        // fills row_chunks with the chunks under the words of the window at
+        // x, y (the first one starts shift cells into row_chunks[0])
+        void windowRow(int64_t x, int64_t y, size_t words, unsigned &shift, unsigned &chunk_row);
+
+        void tickChunk(Chunk &chunk, const Kernel::Compiled &kernel, uint64_t mutation_key, Hue max_mutation);
+
+    public:
+        UnboundedGrid();
+
+        UnboundedGrid(const UnboundedGrid&) = delete;
+        UnboundedGrid& operator=(const UnboundedGrid&) = delete;
+
+        void clear();
+
+        // the window is a board of width x height cells (liveness and hues in
+        // the layout of Grid) with its top left cell at x, y of the plane
+
+        // the plane takes over the cells of the window, liveness and hues
+        void load(const Word *cells, const Hue *hues, size_t width, size_t height, int64_t x, int64_t y);
+
+        // the window takes over the cells of the plane, the hues of dead
+        // cells without a chunk stay as they are
+        void store(Word *cells, Hue *hues, size_t width, size_t height, int64_t x, int64_t y);
+
+        // the same after a tick, for a window that held the previous
+        // generation: only words that changed are written, and only the hues
+        // of cells born. changed_tiles (a flag per word of 64 rows, in the
+        // layout of Grid) are set for them, births and deaths are counted
+        void storeChanges(Word *cells, Hue *hues, size_t width, size_t height, int64_t x, int64_t y,
+                          uint8_t *changed_tiles, uint64_t &births, uint64_t &deaths);
+
+        // newborn cells inherit their hue like on Grid, mutated by
+        // Random::cell(mutation_key, x, y) of their coordinates on the plane
+        void tick(const Kernel::Compiled &kernel, uint64_t mutation_key, Hue max_mutation, ThreadPool &pool);
+
+        uint64_t population() const;
+
+        // chunks in use, and computed in the last tick
+        size_t chunkCount() const;
+        size_t activeChunkCount() const;
+
+        // bytes held by chunks (including the pooled ones) and the hash table
+        size_t memoryUsage() const;
+    };
+}
+
+#endif /* UNBOUNDED_GRID_H */
@@ -4,14 +4,35 @@
 
 namespace RainbowLife {
     
-    Window::Window()
+    Window::Window(Mode mode) :
+        renderer(nullptr),
+        fullscreen(true)
     {
         window = SDL_CreateWindow("Rainbow Life",
                                   SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 0, 0,
-                                  SDL_WINDOW_SHOWN | SDL_WINDOW_FULLSCREEN_DESKTOP | SDL_WINDOW_INPUT_GRABBED);
+                                  SDL_WINDOW_SHOWN | SDL_WINDOW_FULLSCREEN_DESKTOP | SDL_WINDOW_INPUT_GRABBED | SDL_WINDOW_RESIZABLE);
 
         SDL_GetWindowSize(window, &width, &height);
 
+        if (mode == TEXTURE) {
+            // nearest neighbour scaling keeps the cells sharp
+            SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "0");
+
+            renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_PRESENTVSYNC);
+
+            if (renderer == nullptr) {
+                renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE | SDL_RENDERER_PRESENTVSYNC);
+            }
+
+            if (renderer == nullptr) {
+                throw std::runtime_error(SDL_GetError());
+            }
+
+            SDL_RendererInfo info;
+            SDL_GetRendererInfo(renderer, &info);
+            log("renderer: ", info.name);
+        }
+
         SDL_ShowCursor(SDL_DISABLE);
         SDL_ShowWindow(window);
         SDL_RaiseWindow(window);
@@ -19,16 +40,83 @@ namespace RainbowLife {
 
     SDL_Surface* Window::getSurface()
     {
+        // a window has either a surface or a renderer, never both
+        if (renderer != nullptr) {
+            return nullptr;
+        }
+
         return SDL_GetWindowSurface(window);
     }
 
+    SDL_Renderer* Window::getRenderer()
+    {
+        return renderer;
+    }
+
+    void Window::toggleFullscreen()
+    {
+        fullscreen = !fullscreen;
+
+        if (SDL_SetWindowFullscreen(window, fullscreen ? SDL_WINDOW_FULLSCREEN_DESKTOP : 0) != 0) {
+            log("unable to toggle fullscreen: ", SDL_GetError());
+            fullscreen = !fullscreen;
+            return;
+        }
+
+        if (!fullscreen) {
+            SDL_SetWindowSize(window, width * 3 / 4, height * 3 / 4);
+            SDL_SetWindowPosition(window, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED);
+        }
+
+        // the cursor is free to leave a window
+        SDL_SetWindowGrab(window, fullscreen ? SDL_TRUE : SDL_FALSE);
+    }
+
+    int Window::refreshRate()
+    {
+        SDL_DisplayMode mode;
+
+        if (SDL_GetWindowDisplayMode(window, &mode) != 0 || mode.refresh_rate <= 0) {
+            return 60;
+        }
+
+        return mode.refresh_rate;
+    }
+
     void Window::update()
     {
         SDL_UpdateWindowSurface(window);
     }
 
+    void Window::update(const std::vector<SDL_Rect> &rects)
+    {
+        if (!rects.empty()) {
+            SDL_UpdateWindowSurfaceRects(window, rects.data(), rects.size());
+        }
+    }
+
+    void Window::present(SDL_Texture *texture, const SDL_Rect &source, const SDL_Rect &destination,
+                         SDL_Texture *overlay, const SDL_Rect *overlay_destination)
+    {
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+        SDL_RenderClear(renderer);
+        SDL_RenderCopy(renderer, texture, &source, &destination);
+
+        if (overlay != nullptr) {
+            SDL_Rect overlay_source = { 0, 0, overlay_destination->w, overlay_destination->h };
+            SDL_RenderCopy(renderer, overlay, &overlay_source, overlay_destination);
+        }
+
+        SDL_RenderPresent(renderer);
+    }
+
     Window::~Window()
     {
+        if (renderer != nullptr) {
+            SDL_DestroyRenderer(renderer);
+            renderer = nullptr;
+        }
+
         SDL_DestroyWindow(window);
     }
 };
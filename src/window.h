@@ -2,19 +2,54 @@
 #define WINDOW_H
 
 #include <SDL2/SDL.h>
+#include <vector>
 
 namespace RainbowLife {
     class Window {
+    public:
+        enum Mode {
+            // the board is drawn into the window surface by the CPU
+            SURFACE,
+            // the board is streamed into a texture (one texel per cell), which
+            // the renderer scales to the window, works with the software renderer too
+            // presenting waits for vertical sync where the renderer supports it
+            TEXTURE
+        };
+
     private:
         int width, height;
         SDL_Window *window;
+        SDL_Renderer *renderer;
+        bool fullscreen;
 
     public:
-        Window();
+        Window(Mode mode = SURFACE);
+
+        // only in SURFACE mode (nullptr otherwise)
         SDL_Surface* getSurface();
+
+        // only in TEXTURE mode (nullptr otherwise)
+        SDL_Renderer* getRenderer();
+
+        // between fullscreen and a window of three quarters of the display,
+        // see Board::resizeOutput() for following the new size
+        void toggleFullscreen();
+
+        // refresh rate of the display the window is on, in Hz (60 if unknown)
+        int refreshRate();
+
         void update();
+
+        // pushes only the given regions of the surface to the screen
+        void update(const std::vector<SDL_Rect> &rects);
+
+        // scales the source rectangle of the texture into the destination
+        // rectangle and presents it, with the overlay (if any) drawn over it
+        // unscaled, from its top left corner
+        void present(SDL_Texture *texture, const SDL_Rect &source, const SDL_Rect &destination,
+                     SDL_Texture *overlay = nullptr, const SDL_Rect *overlay_destination = nullptr);
         ~Window();
     };
 }
 
-#endif /* WINDOW_H */
\ No newline at end of file
+#endif /* WINDOW_H */